@@ -0,0 +1,627 @@
+// Cost of each path across the C++/Lua boundary, in isolation and in a
+// realistic frame of the actor scripts. Run from the dist directory:
+//
+//     ld41_bench [filter]
+//
+// Each benchmark is run once to warm up and then five times; the fastest run
+// is reported. Allocations include the Lua heap (not with LuaJIT).
+//
+//     ld41_bench --stage <name> [--ticks N] [--lua] [--alloc-budget N] [--warmup N]
+//
+// instead plays data/stages/<name>.json headless for N fixed ticks (600 by
+// default) and reports the cost of each system. The player and ball scripts
+// need input, so they are left off. --lua runs the Lua versions of scripts
+// that have native behaviours. With --alloc-budget, any tick after the first
+// --warmup ticks (60 by default) that allocates more than N times fails the run.
+
+#include "alloc_tracker.hpp"
+#include "behaviour_registry.hpp"
+#include "behaviours.hpp"
+#include "bytecode_cache.hpp"
+#include "command_buffer.hpp"
+#include "component_fields.hpp"
+#include "components.hpp"
+#include "entities.hpp"
+#include "json.hpp"
+#include "lua_allocator.hpp"
+#include "prefabs.hpp"
+#include "profiler.hpp"
+#include "resource_cache.hpp"
+#include "script_registry.hpp"
+#include "script_tasks.hpp"
+#include "scripting.hpp"
+#include "systems.hpp"
+
+#include <sol.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using ent_id = ember_database::ent_id;
+
+constexpr int runs = 5;
+
+struct benchmark {
+    std::string name;
+    std::size_t calls;
+    std::function<void()> setup;
+    std::function<void()> body;
+    std::function<void()> teardown;
+};
+
+struct result {
+    double ns_per_call;
+    double allocs_per_call;
+};
+
+result measure(const benchmark& b) {
+    auto best_ns = std::numeric_limits<std::int64_t>::max();
+    auto best_allocs = std::numeric_limits<std::uint64_t>::max();
+
+    for (int i = 0; i <= runs; ++i) {
+        if (b.setup) {
+            b.setup();
+        }
+        auto allocs = alloc_tracker::get_allocation_count();
+        auto start = profiler::now_ns();
+        b.body();
+        auto ns = profiler::now_ns() - start;
+        allocs = alloc_tracker::get_allocation_count() - allocs;
+        if (b.teardown) {
+            b.teardown();
+        }
+        if (i > 0) {
+            best_ns = std::min(best_ns, ns);
+            best_allocs = std::min(best_allocs, allocs);
+        }
+    }
+
+    return {double(best_ns) / b.calls, double(best_allocs) / b.calls};
+}
+
+nlohmann::json load_json(const std::string& filename) {
+    std::ifstream file (filename);
+    if (!file) {
+        throw std::runtime_error("cannot open " + filename);
+    }
+    nlohmann::json json;
+    file >> json;
+    return json;
+}
+
+// Scripts used only by the dispatch benchmarks; everything else is loaded from data/scripts.
+const std::map<std::string, std::string> bench_scripts = {
+    {"bench/noop",
+        "function update(eid, delta) end\n"
+        "function on_collide(eid1, eid2, aabb) end\n"
+        "function on_enter(eid, other) end\n"
+        "function on_leave(eid, other) end\n"
+        "function on_death(eid) end\n"},
+    {"bench/noop_all",
+        "function update_all(eids, delta, count) end\n"},
+};
+
+// Wraps `body` in `for i = 1, n do ... end`, after `prefix`. The chunk takes (n, eid, eids, com).
+sol::protected_function lua_loop(sol::state& lua, const std::string& prefix, const std::string& body) {
+    auto code = "local n, eid, eids, com = ...\n" + prefix + "\nfor i = 1, n do\n" + body + "\nend\n";
+    auto chunk = lua.load(code);
+    if (!chunk.valid()) {
+        sol::error err = chunk;
+        throw err;
+    }
+    return chunk;
+}
+
+} //static
+
+int main(int argc, char* argv[]) try {
+    auto filter = std::string{};
+    auto stage = std::string{};
+    auto ticks = 600;
+    auto use_lua = false;
+    auto alloc_budget = -1;
+    auto warmup = 60;
+
+    for (int i = 1; i < argc; ++i) {
+        auto arg = std::string(argv[i]);
+        if (arg == "--stage" && i + 1 < argc) {
+            stage = argv[++i];
+        } else if (arg == "--ticks" && i + 1 < argc) {
+            ticks = std::max(std::atoi(argv[++i]), 1);
+        } else if (arg == "--lua") {
+            use_lua = true;
+        } else if (arg == "--alloc-budget" && i + 1 < argc) {
+            alloc_budget = std::max(std::atoi(argv[++i]), 0);
+        } else if (arg == "--warmup" && i + 1 < argc) {
+            warmup = std::max(std::atoi(argv[++i]), 0);
+        } else {
+            filter = arg;
+        }
+    }
+
+    ember_database entities;
+
+#ifdef SOL_LUAJIT
+    sol::state lua;
+    const auto backend = LUAJIT_VERSION;
+#else
+    lua_allocator lua_memory;
+    sol::state lua (sol::detail::default_at_panic, &lua_allocator::alloc, &lua_memory);
+    const auto backend = LUA_RELEASE;
+#endif
+    lua.open_libraries(sol::lib::base, sol::lib::math, sol::lib::string, sol::lib::table);
+
+    auto nlohmann_table = lua.create_named_table("component");
+    nlohmann_table.new_usertype<nlohmann::json>("json");
+
+    lua["entities"] = std::ref(entities);
+
+    auto global_table = sol::table(lua.globals());
+    scripting::register_type<ember_database>(global_table);
+
+    auto component_table = lua.create_named_table("component");
+    component::register_components(component_table);
+
+    auto fields_table = lua.create_named_table("fields");
+    component_fields::register_types(fields_table, component_table, component::all{});
+    component_fields::open_ffi(lua);
+
+    auto bytecode = bytecode_cache("data/scripts/", "data/bytecode/", false, false);
+
+    auto environment_cache = resource_cache<sol::environment, std::string>{[&](const std::string& name) {
+            auto env = sol::environment(lua, sol::create, lua.globals());
+            auto iter = bench_scripts.find(name);
+            auto chunk = iter != end(bench_scripts)
+                ? sol::protected_function(lua.load(iter->second, name))
+                : bytecode.load(lua, name);
+            env.set_on(chunk);
+            auto result = chunk();
+            if (!result.valid()) {
+                sol::error err = result;
+                throw err;
+            }
+            return env;
+        }};
+
+    auto natives = behaviour_registry(entities);
+    behaviours::register_all(natives);
+
+    auto scripts = script_registry(environment_cache);
+    auto native_scripts = script_registry(environment_cache);
+    native_scripts.set_natives(natives);
+
+    auto tasks = script_tasks(lua, entities, scripts);
+    auto native_tasks = script_tasks(lua, entities, native_scripts);
+
+    auto path = sol::table{};
+
+    auto set_path_logic = [&](const std::string& level) {
+        path = scripting::json_to_lua(lua, load_json("data/stages/pathlogic/" + level + "pathlogic.json"));
+        lua["path_logic"] = path;
+        auto& native_path = natives.get_context().path_logic;
+        native_path.clear();
+        for (std::size_t i = 1; i <= path.size(); ++i) {
+            native_path.push_back({path[i]["x"].get<float>(), path[i]["y"].get<float>()});
+        }
+    };
+
+    natives.get_context().play_sfx = [](const std::string&) {};
+    natives.get_context().set_game_state = [](const std::string&) {};
+
+    auto load_entity = [&](const nlohmann::json& json) {
+        auto loader = environment_cache.get("system/loader");
+        return (*loader)["load_entity"](scripting::json_to_lua(lua, json)).get<ent_id>();
+    };
+
+    lua["play_sfx"] = [](const std::string&) {};
+    lua["set_game_state"] = [](const std::string&) {};
+    lua["entity_from_json"] = load_entity;
+
+    const auto enemies = load_json("data/enemies.json");
+    const auto towers = load_json("data/towers.json");
+
+    lua["get_enemy"] = [&](const std::string& name) {
+        for (const auto& enemy : enemies) {
+            if (enemy["name"] == name) {
+                return enemy["template"];
+            }
+        }
+        throw std::runtime_error("Unknown enemy: " + name);
+    };
+
+    prefab_registry prefabs;
+    prefabs.add_all("towers/", towers);
+    prefabs.add_all("enemies/", enemies);
+
+    lua["spawn_prefab"] = [&](const std::string& name, sol::optional<float> x, sol::optional<float> y) {
+        auto eid = prefabs.spawn(entities, name);
+        if (x && y) {
+            entities.create_component(eid, component::position{*x, *y});
+        }
+        return eid;
+    };
+
+    // Stage entities the way main.cpp's load_stage creates them, or all through loader.lua.
+    auto load_stage_entities = [&](const nlohmann::json& stage_entities, bool native) {
+        auto loader = environment_cache.get("system/loader");
+        if (!native) {
+            (*loader)["load_world"](scripting::json_to_lua(lua, stage_entities));
+            return;
+        }
+        sol::protected_function load_components = (*loader)["load_components"];
+        for (const auto& ent : stage_entities) {
+            auto eid = entities.create_entity();
+            auto rest = create_components(entities, eid, ent);
+            if (!rest.is_null()) {
+                load_components(eid, scripting::json_to_lua(lua, rest));
+            }
+        }
+    };
+
+    auto clear_entities = [&]{
+        entities.visit([&](ent_id eid) {
+                entities.destroy_entity(eid);
+            });
+        tasks.clear();
+        native_tasks.clear();
+        lua.collect_garbage();
+    };
+
+    auto eids = std::vector<ent_id>{};
+    auto eid_table = sol::table(lua, sol::create);
+
+    // Creates `n` entities with `make(eid, i)`, also listed in `eid_table` for Lua loops.
+    auto spawn = [&](std::size_t n, const std::function<void(ent_id, std::size_t)>& make) {
+        clear_entities();
+        eids.clear();
+        for (std::size_t i = 0; i < n; ++i) {
+            auto eid = entities.create_entity();
+            make(eid, i);
+            eids.push_back(eid);
+            eid_table[i + 1] = eid;
+        }
+    };
+
+    auto with_position = [&](ent_id eid, std::size_t) {
+        entities.create_component(eid, component::position{});
+    };
+
+    auto with_script = [&](const char* name) {
+        return [&, name](ent_id eid, std::size_t) {
+            entities.create_component(eid, component::position{});
+            entities.create_component(eid, component::script{name});
+        };
+    };
+
+    const auto delta = 1.0 / 60.0;
+    auto commands = command_buffer{};
+
+    // The simulation systems, in the order main.cpp runs them, run on this thread.
+    auto make_systems = [&](script_registry& registry, script_tasks& registry_tasks) {
+        return std::vector<std::pair<std::string, std::function<void()>>>{
+            {"movement", [&]{ systems::movement(entities, delta); }},
+            {"collision", [&]{ systems::collision(entities, delta, registry); }},
+            {"scripting", [&]{ systems::scripting(entities, delta, registry, registry_tasks); }},
+            {"detection", [&]{ systems::detection(entities, delta, registry); }},
+            {"fire_damage", [&]{
+                    systems::fire_damage(entities, delta, commands);
+                    commands.flush(entities);
+                }},
+            {"death_timer", [&]{ systems::death_timer(entities, delta, registry); }},
+        };
+    };
+
+    if (!stage.empty()) {
+        auto& registry = use_lua ? scripts : native_scripts;
+        auto& registry_tasks = use_lua ? tasks : native_tasks;
+        auto frame = make_systems(registry, registry_tasks);
+
+        auto json = load_json("data/stages/" + stage + ".json");
+        for (auto& ent : json["entities"]) {
+            auto iter = ent.find("script");
+            if (iter != ent.end() && ((*iter)["name"] == "player" || (*iter)["name"] == "actor/ball")) {
+                ent.erase(iter);
+            }
+        }
+
+        set_path_logic(stage);
+        auto load_start_ns = profiler::now_ns();
+        load_stage_entities(json["entities"], true);
+        auto load_ns = profiler::now_ns() - load_start_ns;
+
+        struct system_cost {
+            std::int64_t ns = 0;
+            std::int64_t max_ns = 0;
+            std::uint64_t allocs = 0;
+        };
+
+        auto costs = std::vector<system_cost>(frame.size());
+        auto tick_ns = std::int64_t(0);
+        auto max_tick_ns = std::int64_t(0);
+        auto peak_enemies = std::size_t(0);
+        auto peak_bullets = std::size_t(0);
+        auto peak_entities = std::size_t(0);
+        auto max_tick_allocs = std::uint64_t(0);
+        auto over_alloc_budget = 0;
+
+        for (int t = 0; t < ticks; ++t) {
+            auto tick_allocs = alloc_tracker::get_allocation_count();
+            auto tick_start = profiler::now_ns();
+            for (std::size_t i = 0; i < frame.size(); ++i) {
+                auto allocs = alloc_tracker::get_allocation_count();
+                auto start = profiler::now_ns();
+                frame[i].second();
+                auto ns = profiler::now_ns() - start;
+                costs[i].ns += ns;
+                costs[i].max_ns = std::max(costs[i].max_ns, ns);
+                costs[i].allocs += alloc_tracker::get_allocation_count() - allocs;
+            }
+            auto ns = profiler::now_ns() - tick_start;
+            tick_ns += ns;
+            max_tick_ns = std::max(max_tick_ns, ns);
+
+            tick_allocs = alloc_tracker::get_allocation_count() - tick_allocs;
+            if (t >= warmup) {
+                max_tick_allocs = std::max(max_tick_allocs, tick_allocs);
+                if (alloc_budget >= 0 && tick_allocs > std::uint64_t(alloc_budget)) {
+                    if (over_alloc_budget++ == 0) {
+                        std::cerr << "ERROR: Tick " << t << " made " << tick_allocs << " allocations (budget " << alloc_budget << ")" << std::endl;
+                    }
+                }
+            }
+
+            auto num_enemies = std::size_t(0);
+            auto num_bullets = std::size_t(0);
+            auto num_entities = std::size_t(0);
+            entities.visit([&](ent_id) { ++num_entities; });
+            entities.visit([&](component::enemy_tag) { ++num_enemies; });
+            entities.visit([&](component::bullet_tag) { ++num_bullets; });
+            peak_enemies = std::max(peak_enemies, num_enemies);
+            peak_bullets = std::max(peak_bullets, num_bullets);
+            peak_entities = std::max(peak_entities, num_entities);
+        }
+
+        std::printf("Lua backend: %s, %s behaviours\n", backend, use_lua ? "Lua" : "native");
+        std::printf("Stage %s: loaded %zu entities in %.2f ms, %d ticks, peak %zu entities (%zu enemies, %zu bullets)\n",
+            stage.c_str(), json["entities"].size(), load_ns / 1e6, ticks, peak_entities, peak_enemies, peak_bullets);
+        std::printf("%-16s %12s %12s %8s %14s\n", "system", "ms/tick", "max ms", "share", "allocs/tick");
+        for (std::size_t i = 0; i < frame.size(); ++i) {
+            std::printf("%-16s %12.3f %12.3f %7.1f%% %14.1f\n", frame[i].first.c_str(),
+                costs[i].ns / 1e6 / ticks, costs[i].max_ns / 1e6, 100.0 * costs[i].ns / std::max<std::int64_t>(tick_ns, 1),
+                double(costs[i].allocs) / ticks);
+        }
+        std::printf("%-16s %12.3f %12.3f\n", "total", tick_ns / 1e6 / ticks, max_tick_ns / 1e6);
+        std::printf("Most allocations in a tick after %d warmup ticks: %llu\n", warmup, (unsigned long long)max_tick_allocs);
+
+        clear_entities();
+
+        if (over_alloc_budget > 0) {
+            std::cerr << "ERROR: " << over_alloc_budget << " ticks exceeded the allocation budget of " << alloc_budget << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    set_path_logic("level1");
+
+    auto benchmarks = std::vector<benchmark>{};
+
+    // Binding calls from Lua. lua.loop is the cost of the loop itself.
+    const auto lua_calls = std::size_t(100000);
+    auto add_lua = [&](std::string name, std::string prefix, std::string body, std::function<void()> setup = {}) {
+        auto loop = std::make_shared<sol::protected_function>(lua_loop(lua, prefix, body));
+        if (!setup) {
+            setup = [&]{ spawn(1, with_position); };
+        }
+        benchmarks.push_back({std::move(name), lua_calls, std::move(setup), [&, loop]{
+                auto result = (*loop)(lua_calls, eids.front(), eid_table, component::velocity{});
+                if (!result.valid()) {
+                    sol::error err = result;
+                    throw err;
+                }
+            }, clear_entities});
+    };
+
+    add_lua("lua.loop", "", "");
+    add_lua("lua.get_component", "", "local c = entities:get_component(eid, component.position)");
+    add_lua("lua.get_field", "local get_field, x = entities.get_field, fields.position.x", "local v = get_field(entities, eid, x)");
+    add_lua("lua.set_field", "local set_field, x = entities.set_field, fields.position.x", "set_field(entities, eid, x, i)");
+    add_lua("lua.has_component", "", "local b = entities:has_component(eid, component.position)");
+    add_lua("lua.component_new", "", "local c = component.velocity.new()");
+    add_lua("lua.create_component", "", "entities:create_component(eids[i], com)", [&]{ spawn(lua_calls, [](ent_id, std::size_t) {}); });
+
+    // A query for a rare component among many entities, iterated to the end.
+    const auto query_calls = std::size_t(1000);
+    auto query_loop = std::make_shared<sol::protected_function>(lua_loop(lua, "", "for e, v in entities:query(component.velocity, component.position) do end"));
+    benchmarks.push_back({"lua.query(100 of 10000)", query_calls, [&]{
+            spawn(10000, [&](ent_id eid, std::size_t i) {
+                    entities.create_component(eid, component::position{});
+                    if (i % 100 == 0) {
+                        entities.create_component(eid, component::velocity{});
+                    }
+                });
+        }, [&, query_loop]{
+            auto result = (*query_loop)(query_calls, eids.front(), eid_table, component::velocity{});
+            if (!result.valid()) {
+                sol::error err = result;
+                throw err;
+            }
+        }, clear_entities});
+
+    // Conversions done on the C++ side.
+    const auto cpp_calls = std::size_t(10000);
+
+    benchmarks.push_back({"cpp.json_to_lua(enemy)", cpp_calls, {}, [&]{
+            const auto& json = enemies[0]["template"];
+            for (std::size_t i = 0; i < cpp_calls; ++i) {
+                scripting::json_to_lua(lua, json);
+            }
+        }, [&]{ lua.collect_garbage(); }});
+
+    // Spawning an enemy the old way and from its prefab, including the entity itself.
+    benchmarks.push_back({"spawn.entity_from_json(enemy)", cpp_calls, clear_entities, [&]{
+            const auto& json = enemies[0]["template"];
+            for (std::size_t i = 0; i < cpp_calls; ++i) {
+                load_entity(json);
+            }
+        }, clear_entities});
+
+    benchmarks.push_back({"spawn.prefab(enemy)", cpp_calls, clear_entities, [&]{
+            const auto name = "enemies/" + enemies[0]["name"].get<std::string>();
+            for (std::size_t i = 0; i < cpp_calls; ++i) {
+                prefabs.spawn(entities, name);
+            }
+        }, clear_entities});
+
+    // Loading level1's entities, per stage.
+    const auto level1 = load_json("data/stages/level1.json");
+
+    benchmarks.push_back({"stage.load(level1, loader.lua)", 1, clear_entities, [&]{
+            load_stage_entities(level1["entities"], false);
+        }, clear_entities});
+
+    benchmarks.push_back({"stage.load(level1, native)", 1, clear_entities, [&]{
+            load_stage_entities(level1["entities"], true);
+        }, clear_entities});
+
+    add_lua("lua.spawn_prefab", "", "spawn_prefab('enemies/skeleton', 0, 0)");
+
+    auto& noop = scripts.get(scripts.get_handle("bench/noop"));
+
+    benchmarks.push_back({"cpp.on_enter(std::function, converted per call)", cpp_calls, [&]{ spawn(2, with_position); }, [&]{
+            for (std::size_t i = 0; i < cpp_calls; ++i) {
+                auto func = sol::object(noop.on_enter).as<std::function<void(ent_id, ent_id)>>();
+                func(eids[0], eids[1]);
+            }
+        }, clear_entities});
+
+    benchmarks.push_back({"cpp.on_enter(std::function)", cpp_calls, [&]{ spawn(2, with_position); }, [&]{
+            auto func = sol::object(noop.on_enter).as<std::function<void(ent_id, ent_id)>>();
+            for (std::size_t i = 0; i < cpp_calls; ++i) {
+                func(eids[0], eids[1]);
+            }
+        }, clear_entities});
+
+    benchmarks.push_back({"cpp.on_enter(protected_function)", cpp_calls, [&]{ spawn(2, with_position); }, [&]{
+            for (std::size_t i = 0; i < cpp_calls; ++i) {
+                noop.on_enter(eids[0], eids[1]);
+            }
+        }, clear_entities});
+
+    benchmarks.push_back({"cpp.on_enter(script_registry::call)", cpp_calls, [&]{ spawn(2, with_position); }, [&]{
+            for (std::size_t i = 0; i < cpp_calls; ++i) {
+                scripts.call(noop, noop.on_enter, "on_enter", eids[0], eids[1]);
+            }
+        }, clear_entities});
+
+    // Callback dispatch by the systems, per callback.
+    const auto dispatch_entities = std::size_t(1000);
+
+    benchmarks.push_back({"dispatch.update", dispatch_entities, [&]{ spawn(dispatch_entities, with_script("bench/noop")); }, [&]{
+            systems::scripting(entities, delta, scripts, tasks);
+        }, clear_entities});
+
+    benchmarks.push_back({"dispatch.update_all", dispatch_entities, [&]{ spawn(dispatch_entities, with_script("bench/noop_all")); }, [&]{
+            systems::scripting(entities, delta, scripts, tasks);
+        }, clear_entities});
+
+    // Every entity overlaps every other, so each pair calls on_collide twice.
+    const auto colliders = std::size_t(64);
+    benchmarks.push_back({"dispatch.on_collide", colliders * (colliders - 1), [&]{
+            spawn(colliders, [&](ent_id eid, std::size_t i) {
+                    with_script("bench/noop")(eid, i);
+                    entities.create_component(eid, component::aabb{-1, 1, -1, 1});
+                });
+        }, [&]{
+            systems::collision(entities, delta, scripts);
+        }, clear_entities});
+
+    // One tower; every enemy enters its radius, then leaves it.
+    benchmarks.push_back({"dispatch.on_enter+on_leave", 2 * dispatch_entities, [&]{
+            spawn(dispatch_entities, [&](ent_id eid, std::size_t) {
+                    entities.create_component(eid, component::position{});
+                    entities.create_component(eid, component::enemy_tag{});
+                });
+            auto tower = entities.create_entity();
+            entities.create_component(tower, component::position{});
+            entities.create_component(tower, component::script{"bench/noop"});
+            entities.create_component(tower, component::detector{});
+            eids.push_back(tower);
+        }, [&]{
+            auto& detector = entities.get_component<component::detector>(eids.back());
+            detector.radius = 1;
+            systems::detection(entities, delta, scripts);
+            detector.radius = 0;
+            systems::detection(entities, delta, scripts);
+        }, clear_entities});
+
+    benchmarks.push_back({"dispatch.on_death", dispatch_entities, [&]{
+            spawn(dispatch_entities, [&](ent_id eid, std::size_t i) {
+                    with_script("bench/noop")(eid, i);
+                    entities.create_component(eid, component::death_timer{});
+                });
+        }, [&]{
+            systems::death_timer(entities, delta, scripts);
+        }, clear_entities});
+
+    // A stage's worth of towers and enemies from the real templates, run for
+    // `mix_frames` frames. Reported per frame.
+    const auto mix_frames = std::size_t(120);
+    const auto mix_enemies = std::size_t(200);
+
+    auto add_mix = [&](std::string name, script_registry& registry, script_tasks& registry_tasks) {
+        auto frame = std::make_shared<decltype(make_systems(registry, registry_tasks))>(make_systems(registry, registry_tasks));
+        benchmarks.push_back({std::move(name), mix_frames, [&]{
+                clear_entities();
+                for (std::size_t i = 1; i <= path.size(); ++i) {
+                    auto eid = load_entity(towers[i % towers.size()]["template"]);
+                    entities.create_component(eid, component::position{path[i]["x"].get<float>() + 1, path[i]["y"].get<float>()});
+                }
+                for (std::size_t i = 0; i < mix_enemies; ++i) {
+                    auto eid = load_entity(enemies[i % enemies.size()]["template"]);
+                    sol::table point = path[1 + i % path.size()];
+                    entities.create_component(eid, component::position{point["x"].get<float>(), point["y"].get<float>()});
+                    entities.create_component(eid, component::velocity{});
+                }
+            }, [&, frame]{
+                for (std::size_t f = 0; f < mix_frames; ++f) {
+                    for (auto& system : *frame) {
+                        system.second();
+                    }
+                }
+            }, clear_entities});
+    };
+
+    add_mix("mix.actor (per frame)", scripts, tasks);
+    add_mix("mix.actor.native (per frame)", native_scripts, native_tasks);
+
+    std::printf("Lua backend: %s\n", backend);
+    std::printf("%-48s %12s %12s\n", "benchmark", "ns/call", "allocs/call");
+
+    for (const auto& b : benchmarks) {
+        if (b.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        auto r = measure(b);
+        std::printf("%-48s %12.1f %12.2f\n", b.name.c_str(), r.ns_per_call, r.allocs_per_call);
+    }
+
+    clear_entities();
+
+    return EXIT_SUCCESS;
+} catch (const std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+}
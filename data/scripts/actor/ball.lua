@@ -22,14 +22,14 @@ function ball_states.none(eid, ball, delta)
 end
 
 function ball_states.swing(eid, ball, delta)
-    if input.left then
+    if input:down(action.left) then
         ball.angle_vel = math.min(1, ball.angle_vel + delta * 10)
         ball.angle = ball.angle + math.pi/2 * delta * 2 * ball.angle_vel
         if ball.angle > math.pi/2 then
             ball.angle = math.pi/2
         end
     end
-    if input.right then
+    if input:down(action.right) then
         ball.angle_vel = math.min(1, ball.angle_vel + delta * 10)
         ball.angle = ball.angle - math.pi/2 * delta * 2 * ball.angle_vel
         if ball.angle < -math.pi/2 then
@@ -37,14 +37,14 @@ function ball_states.swing(eid, ball, delta)
         end
     end
 
-    if not input.left and not input.right then
+    if not input:down(action.left) and not input:down(action.right) then
         ball.angle_vel = 0
     end
 
     local anim = entities:get_component(ball.marker, component.animation)
     anim.rot = -math.pi/4 + ball.angle
 
-    if input.shoot_pressed then
+    if input:pressed(action.shoot) then
         ball.state = "shoot"
     end
 end
@@ -55,7 +55,7 @@ function ball_states.shoot(eid, ball, delta)
 
     set_powermeter(power)
 
-    if input.shoot_pressed and power > 0 or power > 1 then
+    if input:pressed(action.shoot) and power > 0 or power > 1 then
         local pos = entities:get_component(eid, component.position)
         ball.land_x = pos.x + power * 16.7 * math.cos(ball.angle + math.pi/2)
         ball.land_y = pos.y + power * 16.7 * math.sin(ball.angle + math.pi/2)
@@ -112,11 +112,7 @@ function ball_states.flying(eid, ball, delta)
             end
             if build then
               play_sfx("towerbuild")
-                local tower_eid = entity_from_json(get_selected_tower())
-                local tpos = component.position.new()
-                tpos.x = tposx
-                tpos.y = -tposy
-                entities:create_component(tower_eid, tpos)
+                spawn_prefab(get_selected_prefab(), tposx, -tposy)
             else
                 spawn_dedball(bposx, bposy)
             end
@@ -1,20 +1,40 @@
-function update(eid, delta)
-    local epos = entities:get_component(eid, component.position)
-    local newVel = entities:get_component(eid, component.velocity)
-    local speed = entities:get_component(eid, component.speed)
-    local dest = path_logic[#path_logic]
-    local dx = dest.x - epos.x
-    local dy = dest.y - epos.y
+-- Only uses the worker-safe API, so updates can run on the worker states.
+parallel = true
+
+local get_field = entities.get_field
+local set_field = entities.set_field
+local position_x = fields.position.x
+local position_y = fields.position.y
+local velocity_vx = fields.velocity.vx
+local velocity_vy = fields.velocity.vy
+local speed_speedness = fields.speed.speedness
+
+local function step(eid, delta, dest)
+    local dx = dest.x - get_field(entities, eid, position_x)
+    local dy = dest.y - get_field(entities, eid, position_y)
     local dist = math.sqrt(dx*dx + dy*dy)
     if dist ~= 0 then
-        newVel.vx = dx * speed.speedness / dist
-        newVel.vy = dy * speed.speedness / dist
+        local speed = get_field(entities, eid, speed_speedness)
+        set_field(entities, eid, velocity_vx, dx * speed / dist)
+        set_field(entities, eid, velocity_vy, dy * speed / dist)
     end
     if dist < 0.0625 then
         entities:create_component(eid, component.death_timer.new())
     end
 end
 
+function update(eid, delta)
+    step(eid, delta, path_logic[#path_logic])
+end
+
+-- Called once per frame with every ghost, instead of update per ghost.
+function update_all(eids, delta, count)
+    local dest = path_logic[#path_logic]
+    for i = 1, count do
+        step(eids[i], delta, dest)
+    end
+end
+
 function on_collide(eid1, eid2, aabb)
     local is_bullet = entities:has_component(eid2, component.bullet_tag)
     local is_enemy = entities:has_component(eid2, component.enemy_tag)
@@ -1,8 +1,9 @@
-function update(eid, delta)
-    local spawner = entities:get_component(eid, component.spawner)
+function run(eid)
+    wait(entities:get_component(eid, component.spawner).next_spawn)
+
+    while true do
+        local spawner = entities:get_component(eid, component.spawner)
 
-    spawner.next_spawn = spawner.next_spawn - delta
-    if spawner.next_spawn <= 0 then
         local enemylist = {}
         for i,v in ipairs(spawner.spawnrates) do
             for j=1,v[2] do
@@ -18,18 +19,22 @@ function update(eid, delta)
             table.remove(spawner.spawnrates, enemyidx)
         end
 
-        local enemyMove = entity_from_json(get_enemy(enemyname))
         local epos = entities:get_component(eid, component.position)
+        local enemyMove = spawn_prefab("enemies/"..enemyname, epos.x, epos.y)
         local evel = component.velocity.new()
         evel.vx = 0
         evel.vy = -1
-        entities:create_component(enemyMove, epos)
         entities:create_component(enemyMove, evel)
 
-        spawner.next_spawn = spawner.rate
-        spawner.rate = spawner.rate * spawner.decay
         if #spawner.spawnrates == 0 then
             entities:create_component(eid, component.death_timer.new())
+            return
         end
+
+        local delay = spawner.rate
+        spawner.rate = spawner.rate * spawner.decay
+
+        -- The component may move while waiting, so it's fetched again after.
+        wait(delay)
     end
 end
@@ -1,6 +1,12 @@
+local tower_actions = {
+    action.number_1, action.number_2, action.number_3,
+    action.number_4, action.number_5, action.number_6,
+    action.number_7, action.number_8, action.number_9,
+}
+
 function update(eid, delta)
     for i=1,9 do
-        if input["number_"..i.."_pressed"] then
+        if input:pressed(tower_actions[i]) then
             select_tower(i-1)
         end
     end
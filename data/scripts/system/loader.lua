@@ -1,5 +1,4 @@
-function load_entity(data)
-    local ent = entities:create_entity()
+function load_components(ent, data)
     for k,v in pairs(data) do
         if component[k] ~= nil then
             local com = component[k].new()
@@ -13,6 +12,11 @@ function load_entity(data)
             print("Uknown component: "..k)
         end
     end
+end
+
+function load_entity(data)
+    local ent = entities:create_entity()
+    load_components(ent, data)
     return ent
 end
 
@@ -518,6 +518,8 @@ public:
     using size_type = std::size_t;
     virtual ~component_set() = 0;
     virtual void remove(size_type entid) = 0;
+    // Local patch for LD41 (memory_report.hpp), not in upstream ginseng; reapply after updating.
+    virtual size_type memory_usage() const = 0;
 };
 
 inline component_set::~component_set() = default;
@@ -571,6 +573,13 @@ public:
         return components.size();
     }
 
+    virtual size_type memory_usage() const override final {
+        return sizeof(*this) +
+            entid_to_comid.capacity() * sizeof(size_type) +
+            comid_to_entid.capacity() * sizeof(size_type) +
+            components.capacity() * sizeof(T);
+    }
+
 private:
     std::vector<size_type> entid_to_comid;
     std::vector<size_type> comid_to_entid;
@@ -582,6 +591,9 @@ class component_set_impl<tag<T>> final : public component_set {
 public:
     virtual ~component_set_impl() = default;
     virtual void remove(size_type entid) override final {}
+    virtual size_type memory_usage() const override final {
+        return sizeof(*this);
+    }
 };
 
 // Opaque index
@@ -876,6 +888,32 @@ public:
         return entities[eid].components.get(0);
     }
 
+    // Local patch for LD41 (memory_report.hpp), not in upstream ginseng; reapply after updating.
+    // Covers component_memory_usage, entity_memory_usage and component_set::memory_usage.
+
+    /*! Get the memory used by a component type's storage.
+     *
+     * Counts container capacity, not memory owned by the components themselves.
+     *
+     * @tparam Com Type of the component.
+     * @return Size in bytes, or zero if the type has never been used.
+     */
+    template <typename Com>
+    std::size_t component_memory_usage() {
+        auto com_set = get_com_set<Com>();
+        return com_set ? com_set->memory_usage() : 0;
+    }
+
+    /*! Get the memory used by the entity table.
+     *
+     * @return Size in bytes.
+     */
+    std::size_t entity_memory_usage() const {
+        return entities.capacity() * sizeof(entity) +
+            free_entities.capacity() * sizeof(ent_id) +
+            component_sets.capacity() * sizeof(component_sets[0]);
+    }
+
 private:
     template <typename Com>
     component_set_impl<Com>* get_com_set() {
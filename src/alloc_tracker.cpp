@@ -0,0 +1,176 @@
+#include "alloc_tracker.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace alloc_tracker {
+
+namespace {
+
+constexpr std::size_t table_size = 256;
+
+struct zone_slot {
+    std::atomic<const char*> name = {nullptr};
+    std::atomic<std::uint64_t> count = {0};
+    std::atomic<std::uint64_t> bytes = {0};
+    std::uint64_t last_count = 0;
+    std::uint64_t last_bytes = 0;
+};
+
+std::atomic<std::uint64_t> allocation_count = {0};
+std::atomic<std::uint64_t> allocation_bytes = {0};
+std::atomic<bool> attribution = {false};
+
+// Slot 0 is reserved for allocations outside any zone.
+std::array<zone_slot, table_size> zone_table;
+std::atomic<std::uint64_t> dropped_zones = {0};
+
+std::uint64_t last_allocation_count = 0;
+std::vector<zone_allocs> frame_allocs;
+
+thread_local const char* current_zone = nullptr;
+
+zone_slot* find_slot(const char* name) {
+    if (!name) {
+        return &zone_table[0];
+    }
+    auto hash = (reinterpret_cast<std::uintptr_t>(name) >> 3) * 0x9E3779B97F4A7C15ull;
+    for (std::size_t i = 0; i < table_size - 1; ++i) {
+        auto& slot = zone_table[1 + (hash + i) % (table_size - 1)];
+        auto slot_name = slot.name.load(std::memory_order_acquire);
+        if (slot_name == name) {
+            return &slot;
+        }
+        if (!slot_name) {
+            if (slot.name.compare_exchange_strong(slot_name, name, std::memory_order_acq_rel) || slot_name == name) {
+                return &slot;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void count(std::size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (attribution.load(std::memory_order_relaxed)) {
+        if (auto slot = find_slot(current_zone)) {
+            slot->count.fetch_add(1, std::memory_order_relaxed);
+            slot->bytes.fetch_add(size, std::memory_order_relaxed);
+        } else {
+            dropped_zones.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void* allocate(std::size_t size) {
+    count(size);
+    if (size == 0) {
+        size = 1;
+    }
+    if (auto ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+} //static
+
+std::uint64_t get_allocation_count() {
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+std::uint64_t get_allocation_bytes() {
+    return allocation_bytes.load(std::memory_order_relaxed);
+}
+
+void set_attribution(bool enabled) {
+    attribution.store(enabled, std::memory_order_relaxed);
+}
+
+bool get_attribution() {
+    return attribution.load(std::memory_order_relaxed);
+}
+
+const char* enter_zone(const char* name) {
+    auto prev = current_zone;
+    current_zone = name;
+    return prev;
+}
+
+std::uint64_t frame_mark() {
+    auto total = get_allocation_count();
+    auto frame_total = total - last_allocation_count;
+
+    frame_allocs.clear();
+
+    for (auto& slot : zone_table) {
+        auto count = slot.count.load(std::memory_order_relaxed);
+        auto bytes = slot.bytes.load(std::memory_order_relaxed);
+        if (count != slot.last_count) {
+            frame_allocs.push_back({slot.name.load(std::memory_order_relaxed), count - slot.last_count, bytes - slot.last_bytes});
+        }
+        slot.last_count = count;
+        slot.last_bytes = bytes;
+    }
+
+    std::sort(begin(frame_allocs), end(frame_allocs), [](const zone_allocs& a, const zone_allocs& b) {
+            return a.count > b.count;
+        });
+
+    // Growing the list above allocates; leave that out of the next frame.
+    last_allocation_count = get_allocation_count();
+
+    return frame_total;
+}
+
+const std::vector<zone_allocs>& get_frame_allocs() {
+    return frame_allocs;
+}
+
+zone_allocs get_frame_allocs(const char* name) {
+    // Zones are matched by name, as profiler::frame_mark merges them: the same
+    // name can come from string literals at different addresses.
+    auto result = zone_allocs{name, 0, 0};
+    for (const auto& allocs : frame_allocs) {
+        if (allocs.name == name || (allocs.name && name && std::strcmp(allocs.name, name) == 0)) {
+            result.count += allocs.count;
+            result.bytes += allocs.bytes;
+        }
+    }
+    return result;
+}
+
+void count_allocation(std::size_t size) {
+    count(size);
+}
+
+} //namespace alloc_tracker
+
+void* operator new(std::size_t size) {
+    return alloc_tracker::allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+    return alloc_tracker::allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
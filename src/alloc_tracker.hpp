@@ -0,0 +1,67 @@
+#ifndef LD41_ALLOC_TRACKER_HPP
+#define LD41_ALLOC_TRACKER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*! Process-wide heap allocation counters.
+ *
+ * Fed by the replacement global operator new in alloc_tracker.cpp and by
+ * `count_allocation` for allocators that bypass it, such as the Lua heap.
+ *
+ * When attribution is enabled, every allocation is also charged to the
+ * innermost profiling zone active on the allocating thread (see profiler.hpp),
+ * so a frame's allocations can be broken down by system. Attribution uses a
+ * fixed table and never allocates itself.
+ */
+namespace alloc_tracker {
+
+struct zone_allocs {
+    const char* name; //!< Zone name, or nullptr for allocations outside any zone.
+    std::uint64_t count;
+    std::uint64_t bytes;
+};
+
+/*! Number of allocations since startup, across all threads.
+ */
+std::uint64_t get_allocation_count();
+
+/*! Number of bytes allocated since startup, across all threads.
+ */
+std::uint64_t get_allocation_bytes();
+
+void set_attribution(bool enabled);
+bool get_attribution();
+
+/*! Makes `name` the zone charged for this thread's allocations.
+ *
+ * Returns the previous zone, to be restored with another call when the zone
+ * ends. Called by profiler::zone.
+ */
+const char* enter_zone(const char* name);
+
+/*! Marks the end of a frame.
+ *
+ * Computes per-zone allocations since the previous mark. Returns the frame's
+ * total allocation count.
+ */
+std::uint64_t frame_mark();
+
+/*! Per-zone allocations of the last complete frame, most allocations first.
+ *
+ * Empty unless attribution is enabled.
+ */
+const std::vector<zone_allocs>& get_frame_allocs();
+
+/*! Allocations charged to every zone named `name` in the last complete frame.
+ */
+zone_allocs get_frame_allocs(const char* name);
+
+/*! Counts an allocation made outside operator new, charging the current zone.
+ */
+void count_allocation(std::size_t size);
+
+} //namespace alloc_tracker
+
+#endif //LD41_ALLOC_TRACKER_HPP
@@ -0,0 +1,17 @@
+#include "behaviour_registry.hpp"
+
+behaviour_registry::behaviour_registry(ember_database& entities) :
+    context{entities, {}, {}, {}}
+{}
+
+behaviour* behaviour_registry::get(const std::string& name) const {
+    auto iter = behaviours.find(name);
+    if (iter != end(behaviours)) {
+        return iter->second.get();
+    }
+    return nullptr;
+}
+
+behaviour_context& behaviour_registry::get_context() {
+    return context;
+}
@@ -0,0 +1,83 @@
+#ifndef LD41_BEHAVIOUR_REGISTRY_HPP
+#define LD41_BEHAVIOUR_REGISTRY_HPP
+
+#include "components.hpp"
+#include "entities.hpp"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*! What native behaviours can reach, standing in for the globals Lua scripts use.
+ */
+struct behaviour_context {
+    ember_database& entities;
+    std::vector<glm::vec2> path_logic;
+    std::function<void(const std::string&)> play_sfx;
+    std::function<void(const std::string&)> set_game_state;
+};
+
+/*! Native implementation of an entity script.
+ *
+ * Implements the same callbacks as a Lua script. Callbacks that aren't
+ * overridden do nothing.
+ */
+class behaviour {
+public:
+    using ent_id = ember_database::ent_id;
+
+    virtual ~behaviour() = default;
+
+    /*! Updates every entity running the behaviour this frame.
+     */
+    virtual void update_all(behaviour_context& ctx, const std::vector<ent_id>& eids, double delta) = 0;
+
+    virtual void on_collide(behaviour_context& ctx, ent_id eid, ent_id other, const component::aabb& region) {}
+    virtual void on_enter(behaviour_context& ctx, ent_id eid, ent_id other) {}
+    virtual void on_leave(behaviour_context& ctx, ent_id eid, ent_id other) {}
+    virtual void on_death(behaviour_context& ctx, ent_id eid) {}
+};
+
+/*! Base for behaviours with a per-entity `update(ctx, eid, delta)`.
+ *
+ * The batch loop calls `T::update` directly, so it costs one virtual call per
+ * frame rather than one per entity.
+ */
+template <typename T>
+class basic_behaviour : public behaviour {
+public:
+    void update_all(behaviour_context& ctx, const std::vector<ent_id>& eids, double delta) final {
+        auto& self = static_cast<T&>(*this);
+        for (auto eid : eids) {
+            self.update(ctx, eid, delta);
+        }
+    }
+};
+
+/*! Native behaviours, registered under the script names they replace.
+ */
+class behaviour_registry {
+public:
+    explicit behaviour_registry(ember_database& entities);
+
+    template <typename T, typename... Args>
+    void add(const std::string& name, Args&&... args) {
+        behaviours[name] = std::make_unique<T>(std::forward<Args>(args)...);
+    }
+
+    /*! Returns the behaviour registered as `name`, or null.
+     */
+    behaviour* get(const std::string& name) const;
+
+    behaviour_context& get_context();
+
+private:
+    behaviour_context context;
+    std::unordered_map<std::string, std::unique_ptr<behaviour>> behaviours;
+};
+
+#endif //LD41_BEHAVIOUR_REGISTRY_HPP
@@ -0,0 +1,116 @@
+#include "behaviours.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace behaviours {
+
+namespace {
+
+using ent_id = behaviour::ent_id;
+
+// Steers toward dest at the entity's speed. Returns true once within reach of it.
+bool seek(ember_database& entities, ent_id eid, const glm::vec2& dest) {
+    auto& pos = entities.get_component<component::position>(eid);
+    auto dx = double(dest.x) - pos.x;
+    auto dy = double(dest.y) - pos.y;
+    auto dist = std::sqrt(dx*dx + dy*dy);
+    if (dist != 0) {
+        auto speed = entities.get_component<component::speed>(eid).speedness;
+        auto& vel = entities.get_component<component::velocity>(eid);
+        vel.vx = dx * speed / dist;
+        vel.vy = dy * speed / dist;
+    }
+    return dist < 0.0625;
+}
+
+// Shared on_collide of the enemy scripts. `dead` decides whether the remaining health is fatal.
+template <typename F>
+void collide(behaviour_context& ctx, ent_id eid, ent_id other, F&& dead) {
+    auto& entities = ctx.entities;
+
+    if (entities.has_component<component::bullet_tag>(other)) {
+        auto tower_eid = entities.get_component<component::bullet>(other).tower;
+        if (!entities.exists(tower_eid)) {
+            return;
+        }
+
+        auto& health = entities.get_component<component::health>(eid);
+        auto& detector = entities.get_component<component::detector>(tower_eid);
+        auto& tower = entities.get_component<component::tower>(tower_eid);
+
+        health.max_health -= tower.damage;
+        if (dead(health.max_health)) {
+            auto iter = std::find(begin(detector.entity_list), end(detector.entity_list), eid);
+            if (iter != end(detector.entity_list)) {
+                detector.entity_list.erase(iter);
+            }
+            entities.create_component(eid, component::death_timer{});
+        }
+
+        entities.create_component(other, component::death_timer{});
+    } else if (!entities.has_component<component::enemy_tag>(other) && entities.has_component<component::health>(other)) {
+        auto& other_health = entities.get_component<component::health>(other);
+
+        ctx.play_sfx("playergethit");
+        other_health.max_health -= 1;
+
+        entities.create_component(eid, component::death_timer{});
+
+        if (other_health.max_health <= 0) {
+            entities.create_component(other, component::death_timer{});
+            ctx.set_game_state("game_over");
+        }
+    }
+}
+
+/*! actor/enemy: follows the stage path, dies at its end.
+ */
+class enemy final : public basic_behaviour<enemy> {
+public:
+    void update(behaviour_context& ctx, ent_id eid, double delta) {
+        auto& entities = ctx.entities;
+        auto& path = ctx.path_logic;
+        auto& pathing = entities.get_component<component::pathing>(eid);
+        if (pathing.next_tile < 0 || pathing.next_tile >= int(path.size())) {
+            return;
+        }
+        if (seek(entities, eid, path[pathing.next_tile])) {
+            ++pathing.next_tile;
+            if (pathing.next_tile == int(path.size())) {
+                entities.create_component(eid, component::death_timer{});
+            }
+        }
+    }
+
+    void on_collide(behaviour_context& ctx, ent_id eid, ent_id other, const component::aabb& region) override {
+        collide(ctx, eid, other, [](int health) { return health == 0; });
+    }
+};
+
+/*! actor/ghost: heads straight for the end of the stage path.
+ */
+class ghost final : public basic_behaviour<ghost> {
+public:
+    void update(behaviour_context& ctx, ent_id eid, double delta) {
+        if (ctx.path_logic.empty()) {
+            return;
+        }
+        if (seek(ctx.entities, eid, ctx.path_logic.back())) {
+            ctx.entities.create_component(eid, component::death_timer{});
+        }
+    }
+
+    void on_collide(behaviour_context& ctx, ent_id eid, ent_id other, const component::aabb& region) override {
+        collide(ctx, eid, other, [](int health) { return health <= 0; });
+    }
+};
+
+} //static
+
+void register_all(behaviour_registry& registry) {
+    registry.add<enemy>("actor/enemy");
+    registry.add<ghost>("actor/ghost");
+}
+
+} //namespace behaviours
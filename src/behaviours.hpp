@@ -0,0 +1,14 @@
+#ifndef LD41_BEHAVIOURS_HPP
+#define LD41_BEHAVIOURS_HPP
+
+#include "behaviour_registry.hpp"
+
+namespace behaviours {
+
+/*! Registers the native replacements for actor/enemy and actor/ghost.
+ */
+void register_all(behaviour_registry& registry);
+
+} //namespace behaviours
+
+#endif //LD41_BEHAVIOURS_HPP
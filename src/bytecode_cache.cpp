@@ -0,0 +1,168 @@
+#include "bytecode_cache.hpp"
+
+#include "profiler.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+
+#ifdef SOL_LUAJIT
+const char* const backend = LUAJIT_VERSION;
+#else
+const char* const backend = LUA_RELEASE;
+#endif
+
+// FNV-1a, 64 bit.
+std::uint64_t get_hash(const std::string& str, std::uint64_t hash = 14695981039346656037ull) {
+    for (auto c : str) {
+        hash ^= std::uint8_t(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Covers everything that changes the dumped bytecode, so entries written with
+// other settings are recompiled rather than loaded.
+std::uint64_t get_source_hash(const std::string& source, bool strip) {
+    return get_hash(source, get_hash(strip ? "stripped" : "full", get_hash(backend)));
+}
+
+bool read_file(const std::string& filename, std::string& out) {
+    std::ifstream file (filename, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+int string_writer(lua_State*, const void* p, std::size_t size, void* ud) {
+    static_cast<std::string*>(ud)->append(static_cast<const char*>(p), size);
+    return 0;
+}
+
+sol::protected_function pop_function(lua_State* L) {
+    auto func = sol::protected_function(L, -1);
+    lua_pop(L, 1);
+    return func;
+}
+
+} //static
+
+bytecode_cache::bytecode_cache(std::string source_dir, std::string cache_dir, bool write, bool strip) :
+    source_dir(std::move(source_dir)),
+    cache_dir(std::move(cache_dir)),
+    write(write),
+    strip(strip)
+{}
+
+sol::protected_function bytecode_cache::load(sol::state_view lua, const std::string& name) {
+    EMBER_PROFILE_ZONE("bytecode_cache::load");
+
+    auto L = lua.lua_state();
+    auto path = get_source_path(name);
+    auto chunkname = "@" + path;
+
+    auto source = std::string{};
+    if (!read_file(path, source)) {
+        throw sol::error("cannot open " + path);
+    }
+
+    auto hash = get_source_hash(source, strip);
+
+    auto cached = std::string{};
+    if (read_file(get_cache_path(name), cached) && cached.size() > sizeof(hash) && std::memcmp(cached.data(), &hash, sizeof(hash)) == 0) {
+        if (luaL_loadbufferx(L, cached.data() + sizeof(hash), cached.size() - sizeof(hash), chunkname.c_str(), "b") == LUA_OK) {
+            ++totals.hits;
+            return pop_function(L);
+        }
+        // Bytecode from an incompatible build; recompile and overwrite it.
+        lua_pop(L, 1);
+    }
+
+    if (luaL_loadbufferx(L, source.data(), source.size(), chunkname.c_str(), "t") != LUA_OK) {
+        auto message = std::string(lua_tostring(L, -1));
+        lua_pop(L, 1);
+        throw sol::error(message);
+    }
+
+    ++totals.compiled;
+
+    if (write) {
+        write_entry(L, name, hash);
+    }
+
+    return pop_function(L);
+}
+
+bool bytecode_cache::compile(sol::state_view lua, const std::string& name) {
+    auto L = lua.lua_state();
+    auto path = get_source_path(name);
+    auto chunkname = "@" + path;
+
+    auto source = std::string{};
+    if (!read_file(path, source)) {
+        std::cerr << "ERROR: Cannot open " << path << std::endl;
+        return false;
+    }
+
+    if (luaL_loadbufferx(L, source.data(), source.size(), chunkname.c_str(), "t") != LUA_OK) {
+        std::cerr << "ERROR: " << lua_tostring(L, -1) << std::endl;
+        lua_pop(L, 1);
+        return false;
+    }
+
+    ++totals.compiled;
+
+    auto success = write_entry(L, name, get_source_hash(source, strip));
+    lua_pop(L, 1);
+
+    return success;
+}
+
+const bytecode_cache::stats& bytecode_cache::get_stats() const {
+    return totals;
+}
+
+std::string bytecode_cache::get_source_path(const std::string& name) const {
+    return source_dir + name + ".lua";
+}
+
+std::string bytecode_cache::get_cache_path(const std::string& name) const {
+    auto flat = name;
+    for (auto& c : flat) {
+        if (c == '/') {
+            c = '.';
+        }
+    }
+    return cache_dir + flat + ".luac";
+}
+
+// Expects the compiled chunk on top of the stack, and leaves it there.
+bool bytecode_cache::write_entry(lua_State* L, const std::string& name, std::uint64_t hash) {
+    auto bytecode = std::string(reinterpret_cast<const char*>(&hash), sizeof(hash));
+
+#ifdef SOL_LUAJIT
+    auto status = lua_dump(L, string_writer, &bytecode);
+#else
+    auto status = lua_dump(L, string_writer, &bytecode, strip);
+#endif
+
+    if (status != 0) {
+        return false;
+    }
+
+    std::ofstream file (get_cache_path(name), std::ios::binary);
+    file.write(bytecode.data(), bytecode.size());
+
+    if (!file) {
+        return false;
+    }
+
+    ++totals.written;
+
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef LD41_BYTECODE_CACHE_HPP
+#define LD41_BYTECODE_CACHE_HPP
+
+#include <sol.hpp>
+
+#include <cstdint>
+#include <string>
+
+/*! On-disk cache of compiled Lua chunks.
+ *
+ * Each script `name` is loaded from `source_dir + name + ".lua"`. Its bytecode
+ * is stored in `cache_dir` under a flattened name, prefixed with a hash of the
+ * source text, the Lua backend and `strip`. A cache entry is only used when the
+ * hash matches, so editing a script, switching between Lua and LuaJIT or
+ * changing `strip` just falls back to compiling the source (and rewriting the
+ * entry, if writing is on).
+ *
+ * With `strip` set, bytecode is dumped without debug info, so errors and
+ * lua_sampler stacks from cached chunks carry no file or line. LuaJIT has no
+ * stripping option in its C API and always dumps full bytecode.
+ */
+class bytecode_cache {
+public:
+    struct stats {
+        int hits = 0;
+        int compiled = 0;
+        int written = 0;
+    };
+
+    bytecode_cache(std::string source_dir, std::string cache_dir, bool write, bool strip);
+
+    /*! Returns the chunk for a script, without running it. Throws sol::error if it cannot be loaded.
+     */
+    sol::protected_function load(sol::state_view lua, const std::string& name);
+
+    /*! Compiles a script and writes its cache entry regardless of `write`.
+     */
+    bool compile(sol::state_view lua, const std::string& name);
+
+    const stats& get_stats() const;
+
+private:
+    std::string get_source_path(const std::string& name) const;
+    std::string get_cache_path(const std::string& name) const;
+
+    bool write_entry(lua_State* L, const std::string& name, std::uint64_t hash);
+
+    std::string source_dir;
+    std::string cache_dir;
+    bool write;
+    bool strip;
+    stats totals;
+};
+
+#endif //LD41_BYTECODE_CACHE_HPP
@@ -0,0 +1,67 @@
+#ifndef LD41_COMMAND_BUFFER_HPP
+#define LD41_COMMAND_BUFFER_HPP
+
+#include "entities.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/*! Deferred structural changes to the database.
+ *
+ * Systems that run off the main thread must not create or destroy entities or
+ * components while other systems are visiting the database, so they push the
+ * change here instead. The owner flushes the buffer at a sync point.
+ */
+class command_buffer {
+public:
+    using command = std::function<void(ember_database&)>;
+
+    template <typename F>
+    void push(F&& f) {
+        commands.emplace_back(std::forward<F>(f));
+    }
+
+    template <typename T>
+    void create_component(ember_database::ent_id eid, T com) {
+        push([eid, com=std::move(com)](ember_database& db) mutable {
+                if (db.exists(eid)) {
+                    db.create_component(eid, std::move(com));
+                }
+            });
+    }
+
+    template <typename T>
+    void destroy_component(ember_database::ent_id eid) {
+        push([eid](ember_database& db) {
+                if (db.exists(eid) && db.has_component<T>(eid)) {
+                    db.destroy_component<T>(eid);
+                }
+            });
+    }
+
+    void destroy_entity(ember_database::ent_id eid) {
+        push([eid](ember_database& db) {
+                if (db.exists(eid)) {
+                    db.destroy_entity(eid);
+                }
+            });
+    }
+
+    bool empty() const {
+        return commands.empty();
+    }
+
+    void flush(ember_database& db) {
+        for (std::size_t i = 0; i < commands.size(); ++i) {
+            commands[i](db);
+        }
+        commands.clear();
+    }
+
+private:
+    std::vector<command> commands;
+};
+
+#endif //LD41_COMMAND_BUFFER_HPP
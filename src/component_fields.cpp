@@ -0,0 +1,368 @@
+#include "component_fields.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+
+namespace component_fields {
+
+namespace _detail {
+
+std::vector<type_info>& get_types() {
+    static std::vector<type_info> types;
+    return types;
+}
+
+std::vector<field_info>& get_fields() {
+    static std::vector<field_info> fields;
+    return fields;
+}
+
+std::unordered_map<const void*, int>& get_type_tables() {
+    static std::unordered_map<const void*, int> tables;
+    return tables;
+}
+
+} //namespace _detail
+
+namespace {
+
+void* get_field_ptr(ember_database& db, ember_database::ent_id eid, lua_Integer token, const field_info*& field) {
+    const auto& fields = _detail::get_fields();
+
+#ifndef LD41_UNCHECKED_COMPONENT_ACCESS
+    if (token < 0 || std::size_t(token) >= fields.size()) {
+        std::cerr << "ERROR: Invalid field token " << token << std::endl;
+        return nullptr;
+    }
+#endif
+
+    field = &fields[token];
+    auto com = _detail::get_types()[field->type].get_ptr(db, eid);
+
+#ifndef LD41_UNCHECKED_COMPONENT_ACCESS
+    if (!com) {
+        std::cerr << "ERROR: Attempting to access field " << _detail::get_types()[field->type].name << "." << field->name
+                  << " of entity " << eid.get_index() << " without that component" << std::endl;
+        return nullptr;
+    }
+#endif
+
+    return static_cast<char*>(com) + field->offset;
+}
+
+constexpr int max_query_types = 8;
+
+constexpr std::size_t max_spare_matches = 8;
+
+// Match buffers of finished queries, so a query made every frame doesn't allocate.
+thread_local std::vector<std::vector<ember_database::ent_id>> spare_matches;
+
+struct query_state {
+    ember_database* db = nullptr;
+    std::vector<ember_database::ent_id> matches;
+    std::array<int, max_query_types> types;
+    int num_types = 0;
+    std::size_t next = 0;
+
+    query_state() = default;
+    query_state(query_state&&) = default;
+    query_state& operator=(query_state&&) = default;
+
+    ~query_state() {
+        release();
+    }
+
+    void acquire() {
+        if (!spare_matches.empty()) {
+            matches = std::move(spare_matches.back());
+            spare_matches.pop_back();
+        }
+    }
+
+    void release() {
+        if (matches.capacity() > 0 && spare_matches.size() < max_spare_matches) {
+            matches.clear();
+            spare_matches.push_back(std::move(matches));
+        }
+        matches = {};
+        next = 0;
+    }
+};
+
+bool matches_query(ember_database& db, ember_database::ent_id eid, const query_state& query) {
+    if (!db.exists(eid)) {
+        return false;
+    }
+    const auto& types = _detail::get_types();
+    for (int i = 0; i < query.num_types; ++i) {
+        if (!types[query.types[i]].has(db, eid)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int query_next(lua_State* L) {
+    auto& query = sol::stack::get<query_state&>(L, lua_upvalueindex(1));
+    auto& db = *query.db;
+    const auto& types = _detail::get_types();
+
+    while (query.next < query.matches.size()) {
+        auto eid = query.matches[query.next++];
+        if (matches_query(db, eid, query)) {
+            sol::stack::push(L, eid);
+            for (int i = 0; i < query.num_types; ++i) {
+                types[query.types[i]].push_ref(L, db, eid);
+            }
+            return 1 + query.num_types;
+        }
+    }
+
+    query.release();
+    lua_pushnil(L);
+    return 1;
+}
+
+int get_query_type(lua_State* L, int index) {
+    if (lua_type(L, index) == LUA_TNUMBER) {
+        auto type = lua_tointeger(L, index);
+        if (type >= 0 && std::size_t(type) < _detail::get_types().size()) {
+            return int(type);
+        }
+    } else {
+        const auto& tables = _detail::get_type_tables();
+        auto iter = tables.find(lua_topointer(L, index));
+        if (iter != end(tables)) {
+            return iter->second;
+        }
+    }
+    return -1;
+}
+
+} //static
+
+const type_info& get_type(int type) {
+    return _detail::get_types()[type];
+}
+
+const field_info& get_field(int field) {
+    return _detail::get_fields()[field];
+}
+
+bool has_type(ember_database& db, ember_database::ent_id eid, lua_Integer type) {
+    const auto& types = _detail::get_types();
+
+#ifndef LD41_UNCHECKED_COMPONENT_ACCESS
+    if (type < 0 || std::size_t(type) >= types.size()) {
+        std::cerr << "ERROR: Invalid type token " << type << std::endl;
+        return false;
+    }
+#endif
+
+    return db.exists(eid) && types[type].has(db, eid);
+}
+
+std::string get_ffi_cdef() {
+    const auto& types = _detail::get_types();
+    const auto& fields = _detail::get_fields();
+
+    auto cdef = std::string{};
+
+    for (std::size_t type = 0; type < types.size(); ++type) {
+        if (!types[type].pod) {
+            continue;
+        }
+
+        cdef += "struct ld41_" + std::string(types[type].name) + " {";
+
+        auto cursor = std::size_t(0);
+        auto num_pads = 0;
+        auto pad_to = [&](std::size_t offset) {
+            if (offset > cursor) {
+                cdef += " char _pad" + std::to_string(num_pads++) + "[" + std::to_string(offset - cursor) + "];";
+            }
+        };
+
+        for (const auto& field : fields) {
+            if (field.type != int(type)) {
+                continue;
+            }
+            pad_to(field.offset);
+            switch (field.kind) {
+                case field_kind::float_:
+                    cdef += " float ";
+                    cursor = field.offset + sizeof(float);
+                    break;
+                case field_kind::double_:
+                    cdef += " double ";
+                    cursor = field.offset + sizeof(double);
+                    break;
+                case field_kind::int_:
+                    cdef += " int ";
+                    cursor = field.offset + sizeof(int);
+                    break;
+                case field_kind::int64:
+                    cdef += " int64_t ";
+                    cursor = field.offset + sizeof(std::int64_t);
+                    break;
+            }
+            cdef += field.name;
+            cdef += ";";
+        }
+
+        pad_to(types[type].size);
+        cdef += " };\n";
+    }
+
+    return cdef;
+}
+
+void open_ffi(sol::state& lua) {
+#ifdef SOL_LUAJIT
+    // Opening the library sets the `ffi` global; there is no `require` without sol::lib::package.
+    lua.open_libraries(sol::lib::ffi, sol::lib::jit);
+    sol::table ffi = lua["ffi"];
+    ffi["cdef"](get_ffi_cdef());
+#else
+    (void)lua;
+#endif
+}
+
+int push_field(lua_State* L, ember_database& db, ember_database::ent_id eid, lua_Integer token) {
+    const field_info* field = nullptr;
+    auto ptr = get_field_ptr(db, eid, token, field);
+
+    if (!ptr) {
+        lua_pushnil(L);
+        return 1;
+    }
+
+    switch (field->kind) {
+        case field_kind::float_:
+            lua_pushnumber(L, *static_cast<float*>(ptr));
+            break;
+        case field_kind::double_:
+            lua_pushnumber(L, *static_cast<double*>(ptr));
+            break;
+        case field_kind::int_:
+            lua_pushinteger(L, *static_cast<int*>(ptr));
+            break;
+        case field_kind::int64:
+            lua_pushinteger(L, *static_cast<std::int64_t*>(ptr));
+            break;
+    }
+
+    return 1;
+}
+
+void write_field(ember_database& db, ember_database::ent_id eid, lua_Integer token, lua_Number value) {
+    const field_info* field = nullptr;
+    auto ptr = get_field_ptr(db, eid, token, field);
+
+    if (!ptr) {
+        return;
+    }
+
+    switch (field->kind) {
+        case field_kind::float_:
+            *static_cast<float*>(ptr) = float(value);
+            break;
+        case field_kind::double_:
+            *static_cast<double*>(ptr) = value;
+            break;
+        case field_kind::int_:
+            *static_cast<int*>(ptr) = int(value);
+            break;
+        case field_kind::int64:
+            *static_cast<std::int64_t*>(ptr) = std::int64_t(value);
+            break;
+    }
+}
+
+int lua_get_field(lua_State* L) {
+    auto& db = sol::stack::get<ember_database&>(L, 1);
+    auto eid = sol::stack::get<ember_database::ent_id>(L, 2);
+    return push_field(L, db, eid, lua_tointeger(L, 3));
+}
+
+int lua_set_field(lua_State* L) {
+    auto& db = sol::stack::get<ember_database&>(L, 1);
+    auto eid = sol::stack::get<ember_database::ent_id>(L, 2);
+    write_field(db, eid, lua_tointeger(L, 3), lua_tonumber(L, 4));
+    return 0;
+}
+
+int lua_has_type(lua_State* L) {
+    auto& db = sol::stack::get<ember_database&>(L, 1);
+    auto eid = sol::stack::get<ember_database::ent_id>(L, 2);
+    auto type = lua_type(L, 3) == LUA_TNUMBER ? lua_tointeger(L, 3) : -1;
+    lua_pushboolean(L, has_type(db, eid, type));
+    return 1;
+}
+
+int lua_component_ptr(lua_State* L) {
+    auto& db = sol::stack::get<ember_database&>(L, 1);
+    auto eid = sol::stack::get<ember_database::ent_id>(L, 2);
+    auto type = lua_tointeger(L, 3);
+
+    const auto& types = _detail::get_types();
+
+    if (type < 0 || std::size_t(type) >= types.size() || !types[type].pod) {
+        return luaL_error(L, "component_ptr argument is not a POD component type");
+    }
+
+    if (auto ptr = types[type].get_ptr(db, eid)) {
+        lua_pushlightuserdata(L, ptr);
+    } else {
+        lua_pushnil(L);
+    }
+
+    return 1;
+}
+
+int lua_query(lua_State* L) {
+    auto& db = sol::stack::get<ember_database&>(L, 1);
+    auto num_types = lua_gettop(L) - 1;
+
+    if (num_types < 1 || num_types > max_query_types) {
+        return luaL_error(L, "query expects 1 to %d component types", max_query_types);
+    }
+
+    auto query_types = std::array<int, max_query_types>{};
+    for (int i = 0; i < num_types; ++i) {
+        auto type = get_query_type(L, i + 2);
+        if (type < 0) {
+            return luaL_error(L, "query argument %d is not a component type", i + 1);
+        }
+        query_types[i] = type;
+    }
+
+    // Built only now, since luaL_error would skip its destructor.
+    auto query = query_state{};
+    query.db = &db;
+    query.types = query_types;
+    query.num_types = num_types;
+
+    const auto& types = _detail::get_types();
+    auto driver = std::find_if(begin(query.types), begin(query.types) + query.num_types, [&](int type) {
+            return types[type].collect != nullptr;
+        });
+
+    query.acquire();
+    if (driver != begin(query.types) + query.num_types) {
+        types[*driver].collect(db, query.matches);
+    } else {
+        db.visit([&](ember_database::ent_id eid) {
+                if (matches_query(db, eid, query)) {
+                    query.matches.push_back(eid);
+                }
+            });
+    }
+
+    sol::stack::push(L, std::move(query));
+    lua_pushcclosure(L, &query_next, 1);
+    return 1;
+}
+
+} //namespace component_fields
@@ -0,0 +1,249 @@
+#ifndef LD41_COMPONENT_FIELDS_HPP
+#define LD41_COMPONENT_FIELDS_HPP
+
+#include "entities.hpp"
+#include "utility.hpp"
+
+#include <Meta.h>
+#include <sol.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/*! Fast-path access to numeric component fields from Lua.
+ *
+ * Every registered component type gets a type token, and every numeric member
+ * a field token, both plain integers computed once from the meta member
+ * tables. Scripts look tokens up once:
+ *
+ *     local pos_x = fields.position.x
+ *     local x = entities:get_field(eid, pos_x)
+ *     entities:set_field(eid, pos_x, x + 1)
+ *
+ * A field access is then one component lookup and a read or write at a
+ * precomputed offset, without a component userdata or a usertype dispatch per
+ * field.
+ *
+ * Unless built with LD41_UNCHECKED_COMPONENT_ACCESS, accesses to missing
+ * entities or components log an error and yield nil.
+ */
+namespace component_fields {
+
+enum class field_kind {
+    float_,
+    double_,
+    int_,
+    int64,
+};
+
+struct type_info {
+    const char* name;
+    void* (*get_ptr)(ember_database& db, ember_database::ent_id eid);
+    bool (*has)(ember_database& db, ember_database::ent_id eid);
+    void (*push_ref)(lua_State* L, ember_database& db, ember_database::ent_id eid);
+    void (*collect)(ember_database& db, std::vector<ember_database::ent_id>& eids); // appends every entity with the component; null for tags
+    std::size_t size;
+    bool pod; // every member is a field, so the layout can be described to the LuaJIT FFI
+};
+
+struct field_info {
+    int type;
+    std::size_t offset;
+    field_kind kind;
+    const char* name;
+};
+
+namespace _detail {
+
+std::vector<type_info>& get_types();
+std::vector<field_info>& get_fields();
+
+/*! Maps the Lua table of each component usertype (e.g. `component.position`) to its type token.
+ */
+std::unordered_map<const void*, int>& get_type_tables();
+
+template <typename T>
+void* get_component_ptr(ember_database& db, ember_database::ent_id eid) {
+#ifndef LD41_UNCHECKED_COMPONENT_ACCESS
+    if (!db.exists(eid) || !db.has_component<T>(eid)) {
+        return nullptr;
+    }
+#endif
+    return &db.get_component<T>(eid);
+}
+
+template <typename T>
+bool has_component(ember_database& db, ember_database::ent_id eid) {
+    return db.has_component<T>(eid);
+}
+
+template <typename T>
+void push_component_ref(lua_State* L, ember_database& db, ember_database::ent_id eid) {
+    sol::stack::push(L, std::ref(db.get_component<T>(eid)));
+}
+
+template <typename T>
+void collect_entities(ember_database& db, std::vector<ember_database::ent_id>& eids) {
+    db.visit([&](ember_database::ent_id eid, T&) {
+            eids.push_back(eid);
+        });
+}
+
+inline void push_tag(lua_State* L, ember_database&, ember_database::ent_id) {
+    lua_pushboolean(L, true);
+}
+
+template <typename T>
+void register_type_table(sol::table& component_table, int type) {
+    sol::object com = component_table[meta::getName<T>()];
+    if (com.valid()) {
+        auto L = component_table.lua_state();
+        com.push();
+        get_type_tables()[lua_topointer(L, -1)] = type;
+        lua_pop(L, 1);
+    }
+}
+
+template <typename T>
+constexpr bool is_field_kind = std::is_same<T, float>::value || std::is_same<T, double>::value
+    || std::is_same<T, int>::value || std::is_same<T, std::int64_t>::value;
+
+template <typename T>
+constexpr field_kind get_field_kind() {
+    return std::is_same<T, float>::value ? field_kind::float_
+        : std::is_same<T, double>::value ? field_kind::double_
+        : std::is_same<T, int>::value ? field_kind::int_
+        : field_kind::int64;
+}
+
+template <typename T>
+void register_type(sol::table& fields_table, sol::table& component_table, std::true_type) {
+    auto& types = get_types();
+    auto type = int(types.size());
+    types.push_back({meta::getName<T>(), &get_component_ptr<T>, &has_component<T>, &push_component_ref<T>, &collect_entities<T>, sizeof(T), false});
+    register_type_table<T>(component_table, type);
+
+    auto table = fields_table.create_named(meta::getName<T>());
+    table["_type"] = type;
+
+    const auto sample = T{};
+    auto num_members = 0;
+    auto num_fields = 0;
+    meta::doForAllMembers<T>([&](auto& member) {
+            using member_type = meta::get_member_type<decltype(member)>;
+            ++num_members;
+            if constexpr (is_field_kind<member_type>) {
+                auto offset = std::size_t(reinterpret_cast<const char*>(&(sample.*member.getPtr())) - reinterpret_cast<const char*>(&sample));
+                auto& fields = get_fields();
+                table[member.getName()] = int(fields.size());
+                fields.push_back({type, offset, get_field_kind<member_type>(), member.getName()});
+                ++num_fields;
+            }
+        });
+
+    if (num_fields == num_members && std::is_trivially_copyable<T>::value) {
+        types[type].pod = true;
+        table["_ctype"] = "struct ld41_" + std::string(meta::getName<T>()) + "*";
+    }
+}
+
+// Tags have no storage, only a type token for has_component.
+template <typename T>
+void register_type(sol::table& fields_table, sol::table& component_table, std::false_type) {
+    auto& types = get_types();
+    auto type = int(types.size());
+    types.push_back({meta::getName<T>(), nullptr, &has_component<T>, &push_tag, nullptr, 0, false});
+    register_type_table<T>(component_table, type);
+
+    auto table = fields_table.create_named(meta::getName<T>());
+    table["_type"] = type;
+}
+
+template <typename T>
+struct is_tag : std::false_type {};
+
+template <typename T>
+struct is_tag<ginseng::tag<T>> : std::true_type {};
+
+} //namespace _detail
+
+/*! Registers tokens for every component in `Coms` into `fields_table`.
+ *
+ * `component_table` must already hold the component usertypes, so queries can
+ * accept them in place of type tokens. Must be called once, before any script runs.
+ */
+template <typename... Coms>
+void register_types(sol::table& fields_table, sol::table& component_table, utility::type_list<Coms...>) {
+    (_detail::register_type<Coms>(fields_table, component_table, std::integral_constant<bool, !_detail::is_tag<Coms>::value>{}), ...);
+}
+
+const type_info& get_type(int type);
+const field_info& get_field(int field);
+
+/*! Whether `eid` exists and has the component with type token `type`. False for an invalid token.
+ */
+bool has_type(ember_database& db, ember_database::ent_id eid, lua_Integer type);
+
+/*! C declarations of every POD component, for `ffi.cdef`.
+ *
+ * Each becomes `struct ld41_<name>`, with explicit padding so the layout
+ * matches the C++ one exactly.
+ */
+std::string get_ffi_cdef();
+
+/*! Declares the POD components to the LuaJIT FFI.
+ *
+ * Does nothing unless built against LuaJIT (SOL_LUAJIT).
+ */
+void open_ffi(sol::state& lua);
+
+/*! Pushes a field of an entity's component onto the Lua stack, or nil if it has no such component.
+ */
+int push_field(lua_State* L, ember_database& db, ember_database::ent_id eid, lua_Integer token);
+
+/*! Writes a field of an entity's component, if it has that component.
+ */
+void write_field(ember_database& db, ember_database::ent_id eid, lua_Integer token, lua_Number value);
+
+/*! `entities:get_field(eid, field)`, as a raw Lua C function.
+ */
+int lua_get_field(lua_State* L);
+
+/*! `entities:set_field(eid, field, value)`, as a raw Lua C function.
+ */
+int lua_set_field(lua_State* L);
+
+/*! `entities:has_type(eid, type)`, as a raw Lua C function.
+ */
+int lua_has_type(lua_State* L);
+
+/*! `entities:component_ptr(eid, type)`, as a raw Lua C function.
+ *
+ * Returns the address of a component as a light userdata, for use with
+ * `ffi.cast(fields.<name>._ctype, ptr)`. The address is only valid until the
+ * next component of that type is created or destroyed.
+ */
+int lua_component_ptr(lua_State* L);
+
+/*! `entities:query(type, ...)`, as a raw Lua C function.
+ *
+ * Types are component usertypes or type tokens. Returns an iterator for a
+ * generic for loop yielding each matching entity followed by a reference to
+ * each requested component, in argument order (`true` for tags):
+ *
+ *     for eid, pos in entities:query(component.position, component.enemy_tag) do
+ *
+ * Matches are collected when the query is made, by visiting the storage of
+ * the first non-tag type, so put the rarest component first. A query of only
+ * tags visits every entity. Entities that lose a component or are destroyed
+ * during the loop are skipped.
+ */
+int lua_query(lua_State* L);
+
+} //namespace component_fields
+
+#endif //LD41_COMPONENT_FIELDS_HPP
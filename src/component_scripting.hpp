@@ -1,6 +1,7 @@
 #ifndef LD41_COMPONENT_SCRIPTING_HPP
 #define LD41_COMPONENT_SCRIPTING_HPP
 
+#include "command_buffer.hpp"
 #include "json.hpp"
 #include "scripting.hpp"
 
@@ -32,14 +33,28 @@ void new_component_usertype(sol::table& lua, const std::string& name, Args&&...
             db.destroy_component<T>(eid);
         },
         "_get_component", [=](ember_database& db, ember_database::ent_id eid) -> std::reference_wrapper<T> {
+#ifndef LD41_UNCHECKED_COMPONENT_ACCESS
             if (!db.exists(eid)) {
                 std::cerr << "ERROR: Attempting to get component " << name << " from nonexistant entity " << eid.get_index() << std::endl;
             }
             if (!db.has_component<T>(eid)) {
                 std::cerr << "ERROR: Attempting to get nonexistant component " << name << " from entity " << eid.get_index() << std::endl;
             }
+#endif
             return std::ref(db.get_component<T>(eid));
         },
+        "_copy_component", [](ember_database& db, ember_database::ent_id eid) -> sol::optional<T> {
+            if (!db.exists(eid) || !db.has_component<T>(eid)) {
+                return sol::nullopt;
+            }
+            return db.get_component<T>(eid);
+        },
+        "_defer_create_component", [](command_buffer& commands, ember_database::ent_id eid, T com) {
+            commands.create_component(eid, std::move(com));
+        },
+        "_defer_destroy_component", [](command_buffer& commands, ember_database::ent_id eid) {
+            commands.destroy_component<T>(eid);
+        },
         "_has_component", [=](ember_database& db, ember_database::ent_id eid) {
             if (!db.exists(eid)) {
                 std::cerr << "ERROR: Attempting to check component " << name << " for nonexistant entity " << eid.get_index() << std::endl;
@@ -60,6 +75,12 @@ void new_component_usertype(sol::table& lua, const std::string& name, Args&&...
         "_destroy_component", [](ember_database& db, ember_database::ent_id eid) {
             db.destroy_component<T>(eid);
         },
+        "_defer_create_component", [](command_buffer& commands, ember_database::ent_id eid, T com) {
+            commands.create_component(eid, std::move(com));
+        },
+        "_defer_destroy_component", [](command_buffer& commands, ember_database::ent_id eid) {
+            commands.destroy_component<T>(eid);
+        },
         "_has_component", [=](ember_database& db, ember_database::ent_id eid) {
             if (!db.exists(eid)) {
                 std::cerr << "ERROR: Attempting to check tag " << name << " for nonexistant entity " << eid.get_index() << std::endl;
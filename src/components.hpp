@@ -74,6 +74,8 @@ REGISTER(aabb,
 
 struct script {
     std::string name;
+    int handle = -1; // script_registry handle, resolved from name on first dispatch
+    bool started = false; // whether run() has been started for this entity
 };
 
 REGISTER(script,
@@ -216,6 +218,26 @@ REGISTER(enemy_tag)
 using bullet_tag = ginseng::tag<struct bullet_tag_t>;
 REGISTER(bullet_tag)
 
+using all = utility::type_list<
+    net_id,
+    position,
+    velocity,
+    aabb,
+    script,
+    detector,
+    tower,
+    ball,
+    animation,
+    death_timer,
+    bullet,
+    health,
+    speed,
+    pathing,
+    spawner,
+    fire_damage,
+    enemy_tag,
+    bullet_tag>;
+
 } //namespace component
 
 #undef MEMBER
@@ -1,5 +1,6 @@
 #include "entities.hpp"
 
+#include "component_fields.hpp"
 #include "components.hpp"
 
 #include <iostream>
@@ -75,7 +76,12 @@ void register_type<ember_database>(sol::table& lua) {
         },
         "has_component", [](ember_database& db, ember_database::ent_id eid, sol::table com_type){
             return com_type["_has_component"](db, eid);
-        });
+        },
+        "get_field", &component_fields::lua_get_field,
+        "set_field", &component_fields::lua_set_field,
+        "has_type", &component_fields::lua_has_type,
+        "query", &component_fields::lua_query,
+        "component_ptr", &component_fields::lua_component_ptr);
 }
 
 } //namespace scripting
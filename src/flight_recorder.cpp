@@ -0,0 +1,147 @@
+#include "flight_recorder.hpp"
+
+#include "alloc_tracker.hpp"
+#include "json.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+flight_recorder::flight_recorder(std::size_t num_frames, double budget_ms, std::string dump_prefix) :
+    frames(num_frames),
+    last_allocations(alloc_tracker::get_allocation_count()),
+    last_end_ns(profiler::now_ns()),
+    dump_prefix(std::move(dump_prefix))
+{
+    set_budget(budget_ms);
+}
+
+void flight_recorder::record(std::size_t lua_heap_bytes, std::int64_t gc_ns) {
+    auto now = profiler::now_ns();
+    auto allocations = alloc_tracker::get_allocation_count();
+
+    auto& rec = frames[next_index % frames.size()];
+    rec.index = next_index;
+    rec.frame_ns = now - last_end_ns;
+    rec.allocations = allocations - last_allocations;
+    rec.lua_heap_bytes = lua_heap_bytes;
+    rec.gc_ns = gc_ns;
+    rec.num_zones = 0;
+
+    // Keep the zones with the most self time, so the zones enclosing a slow one
+    // don't crowd it out, and always leave room for marks since they sort last.
+    const auto& stats = profiler::get_frame_stats();
+    for (const auto& stat : stats) {
+        if (stat.instant) {
+            continue;
+        }
+        auto i = rec.num_zones;
+        if (i == max_zones / 2) {
+            if (stat.self_ns <= rec.zones[i - 1].self_ns) {
+                continue;
+            }
+            --i;
+        } else {
+            ++rec.num_zones;
+        }
+        for (; i > 0 && rec.zones[i - 1].self_ns < stat.self_ns; --i) {
+            rec.zones[i] = rec.zones[i - 1];
+        }
+        rec.zones[i] = stat;
+    }
+    for (const auto& stat : stats) {
+        if (rec.num_zones == max_zones) {
+            break;
+        }
+        if (stat.instant) {
+            rec.zones[rec.num_zones++] = stat;
+        }
+    }
+
+    ++next_index;
+
+    if (rec.frame_ns > budget_ns && rec.index >= cooldown_until) {
+        auto filename = dump_prefix + std::to_string(rec.index) + ".json";
+        if (dump(filename, rec)) {
+            std::clog << "Warning: Frame " << rec.index << " took " << rec.frame_ns / 1e6 << "ms, wrote " << filename << std::endl;
+        }
+        cooldown_until = rec.index + frames.size();
+    }
+
+    // Allocations made by the dump belong to the dump, not to the next frame.
+    last_allocations = alloc_tracker::get_allocation_count();
+    last_end_ns = profiler::now_ns();
+}
+
+void flight_recorder::set_budget(double budget_ms) {
+    budget_ns = std::int64_t(budget_ms * 1e6);
+}
+
+bool flight_recorder::dump(const std::string& filename, const frame_record& spike) const {
+    using json = nlohmann::json;
+
+    auto to_json = [](const frame_record& rec) {
+        auto j = json::object();
+        j["index"] = rec.index;
+        j["frame_ms"] = rec.frame_ns / 1e6;
+        j["allocations"] = rec.allocations;
+        j["lua_heap_bytes"] = rec.lua_heap_bytes;
+        j["gc_ms"] = rec.gc_ns / 1e6;
+        j["zones"] = json::array();
+        for (std::size_t i = 0; i < rec.num_zones; ++i) {
+            auto& zone = rec.zones[i];
+            j["zones"].push_back({
+                {"name", zone.name},
+                {"ms", zone.total_ns / 1e6},
+                {"self_ms", zone.self_ns / 1e6},
+                {"count", zone.count},
+                {"instant", zone.instant}});
+        }
+        return j;
+    };
+
+    auto j = json::object();
+    j["budget_ms"] = budget_ns / 1e6;
+    j["spike"] = to_json(spike);
+    j["causes"] = get_causes(spike);
+    j["frames"] = json::array();
+
+    auto count = std::min<std::uint64_t>(next_index, frames.size());
+    for (auto i = next_index - count; i < next_index; ++i) {
+        j["frames"].push_back(to_json(frames[i % frames.size()]));
+    }
+
+    std::ofstream file (filename);
+    file << j.dump(1) << std::endl;
+
+    return bool(file);
+}
+
+std::vector<std::string> flight_recorder::get_causes(const frame_record& spike) const {
+    auto causes = std::vector<std::string>{};
+
+    for (std::size_t i = 0; i < spike.num_zones; ++i) {
+        auto& zone = spike.zones[i];
+        if (zone.instant) {
+            causes.push_back(std::string(zone.name) + " x" + std::to_string(zone.count));
+        } else if (zone.self_ns * 4 > spike.frame_ns) {
+            // Self time, so "simulation" isn't blamed for the system running inside it.
+            causes.push_back(std::string(zone.name) + " " + std::to_string(zone.self_ns / 1000000.0) + "ms self x" + std::to_string(zone.count));
+        }
+    }
+
+    if (spike.gc_ns * 4 > spike.frame_ns) {
+        causes.push_back("lua gc " + std::to_string(spike.gc_ns / 1000000.0) + "ms");
+    }
+
+    auto count = std::min<std::uint64_t>(next_index, frames.size());
+    auto total_allocations = std::uint64_t(0);
+    for (auto i = next_index - count; i < next_index; ++i) {
+        total_allocations += frames[i % frames.size()].allocations;
+    }
+    if (count > 0 && spike.allocations > 4 * total_allocations / count) {
+        causes.push_back("allocation burst " + std::to_string(spike.allocations));
+    }
+
+    return causes;
+}
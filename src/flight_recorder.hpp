@@ -0,0 +1,59 @@
+#ifndef LD41_FLIGHT_RECORDER_HPP
+#define LD41_FLIGHT_RECORDER_HPP
+
+#include "profiler.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*! Always-on record of the last few seconds of frames.
+ *
+ * Each frame keeps its duration, heap allocation count, Lua heap size, Lua GC
+ * time and the profiler zones with the most self time, and marks. When a frame exceeds the
+ * budget, the whole window is written to `<dump_prefix><frame>.json` along with the likely
+ * causes.
+ *
+ * Recording does not allocate; only dumps do.
+ */
+class flight_recorder {
+public:
+    static constexpr std::size_t max_zones = 8;
+
+    struct frame_record {
+        std::uint64_t index = 0;
+        std::int64_t frame_ns = 0;
+        std::uint64_t allocations = 0;
+        std::size_t lua_heap_bytes = 0;
+        std::int64_t gc_ns = 0;
+        std::size_t num_zones = 0;
+        std::array<profiler::zone_stat, max_zones> zones;
+    };
+
+    flight_recorder(std::size_t num_frames, double budget_ms, std::string dump_prefix);
+
+    /*! Records the frame that just ended.
+     *
+     * Must be called after `profiler::frame_mark()`.
+     */
+    void record(std::size_t lua_heap_bytes, std::int64_t gc_ns);
+
+    void set_budget(double budget_ms);
+
+    bool dump(const std::string& filename, const frame_record& spike) const;
+
+private:
+    std::vector<std::string> get_causes(const frame_record& spike) const;
+
+    std::vector<frame_record> frames;
+    std::uint64_t next_index = 0;
+    std::uint64_t last_allocations = 0;
+    std::uint64_t cooldown_until = 0;
+    std::int64_t last_end_ns = 0;
+    std::int64_t budget_ns = 0;
+    std::string dump_prefix;
+};
+
+#endif //LD41_FLIGHT_RECORDER_HPP
@@ -106,6 +106,16 @@ const msdf_font::glyph& msdf_font::get_glyph(int unicode) const {
     return iter->second;
 }
 
+std::size_t msdf_font::memory_usage() const {
+    auto bytes = std::size_t(0);
+    for (const auto& entry : glyphs) {
+        bytes += sizeof(entry);
+        bytes += std::size_t(entry.second.texture.width) * entry.second.texture.height * 4;
+        bytes += 4 * 8 * sizeof(float); // position, normal, texcoord per vertex
+    }
+    return bytes;
+}
+
 //msdf_font::msdf_font(const std::string& fontname) {
 //    auto fontpath = "data/fonts/" + fontname;
 //    auto fontfilename = fontpath + "/" + fontname + ".json";
@@ -31,6 +31,10 @@ public:
 
     const glyph& get_glyph(int unicode) const;
 
+    /*! Bytes held by the generated glyph textures and meshes.
+     */
+    std::size_t memory_usage() const;
+
 private:
     std::unique_ptr<msdfgen::FontHandle, FontDeleter> font;
     mutable std::unordered_map<int, glyph> glyphs;
@@ -0,0 +1,74 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+namespace {
+
+constexpr std::size_t default_block_size = 64 * 1024;
+
+std::atomic<std::size_t> frame_epoch = {0};
+
+std::size_t align_up(std::size_t offset, std::size_t align) {
+    return (offset + align - 1) & ~(align - 1);
+}
+
+} //static
+
+frame_arena::frame_arena(std::size_t block_size) {
+    blocks.push_back({std::make_unique<char[]>(block_size), block_size});
+}
+
+void* frame_arena::allocate(std::size_t size, std::size_t align) {
+    auto& current = blocks.back();
+    auto base = reinterpret_cast<std::uintptr_t>(current.data.get());
+    auto start = align_up(base + offset, align) - base;
+
+    if (start + size > current.size) {
+        used_in_previous += offset;
+        auto block_size = std::max(current.size * 2, size + align);
+        blocks.push_back({std::make_unique<char[]>(block_size), block_size});
+        offset = 0;
+        return allocate(size, align);
+    }
+
+    offset = start + size;
+    return current.data.get() + start;
+}
+
+void frame_arena::reset() {
+    if (blocks.size() > 1) {
+        auto total = get_capacity();
+        blocks.clear();
+        blocks.push_back({std::make_unique<char[]>(total), total});
+    }
+    offset = 0;
+    used_in_previous = 0;
+}
+
+std::size_t frame_arena::get_used() const {
+    return used_in_previous + offset;
+}
+
+std::size_t frame_arena::get_capacity() const {
+    auto total = std::size_t(0);
+    for (const auto& b : blocks) {
+        total += b.size;
+    }
+    return total;
+}
+
+frame_arena& frame_arena::local() {
+    thread_local frame_arena arena (default_block_size);
+    auto epoch = frame_epoch.load(std::memory_order_acquire);
+    if (arena.epoch != epoch) {
+        arena.reset();
+        arena.epoch = epoch;
+    }
+    return arena;
+}
+
+void frame_arena::end_frame() {
+    frame_epoch.fetch_add(1, std::memory_order_release);
+}
@@ -0,0 +1,92 @@
+#ifndef LD41_FRAME_ARENA_HPP
+#define LD41_FRAME_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*! Linear allocator for data that lives at most until the end of the frame.
+ *
+ * Each thread has its own arena, reached through `local()`. Allocation bumps a
+ * pointer and deallocation does nothing; the whole arena is reclaimed at once
+ * the first time the thread allocates after `end_frame()`. If a frame outgrows
+ * the arena, extra blocks are chained and then merged into one larger block on
+ * the next reset, so steady-state frames do not touch the heap.
+ */
+class frame_arena {
+public:
+    explicit frame_arena(std::size_t block_size);
+
+    frame_arena(const frame_arena&) = delete;
+    frame_arena& operator=(const frame_arena&) = delete;
+
+    void* allocate(std::size_t size, std::size_t align);
+
+    /*! Frees everything allocated so far.
+     */
+    void reset();
+
+    std::size_t get_used() const;
+    std::size_t get_capacity() const;
+
+    /*! The calling thread's arena, reset if a frame has ended since its last use.
+     */
+    static frame_arena& local();
+
+    /*! Invalidates all frame allocations on every thread.
+     */
+    static void end_frame();
+
+private:
+    struct block {
+        std::unique_ptr<char[]> data;
+        std::size_t size;
+    };
+
+    std::vector<block> blocks;
+    std::size_t offset = 0;
+    std::size_t used_in_previous = 0;
+    std::size_t epoch = 0;
+};
+
+/*! Standard allocator adaptor over a frame_arena.
+ */
+template <typename T>
+class arena_allocator {
+public:
+    using value_type = T;
+
+    arena_allocator() : arena(&frame_arena::local()) {}
+    explicit arena_allocator(frame_arena& arena) : arena(&arena) {}
+
+    template <typename U>
+    arena_allocator(const arena_allocator<U>& other) : arena(other.get_arena()) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, std::size_t) {}
+
+    frame_arena* get_arena() const {
+        return arena;
+    }
+
+private:
+    frame_arena* arena;
+};
+
+template <typename T, typename U>
+bool operator==(const arena_allocator<T>& a, const arena_allocator<U>& b) {
+    return a.get_arena() == b.get_arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const arena_allocator<T>& a, const arena_allocator<U>& b) {
+    return !(a == b);
+}
+
+template <typename T>
+using frame_vector = std::vector<T, arena_allocator<T>>;
+
+#endif //LD41_FRAME_ARENA_HPP
@@ -0,0 +1,163 @@
+#include "frame_timing.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+constexpr int sub_bucket_bits = 4;
+constexpr std::uint64_t sub_bucket_count = 1 << sub_bucket_bits;
+
+int highest_bit(std::uint64_t v) {
+    auto bit = -1;
+    while (v) {
+        v >>= 1;
+        ++bit;
+    }
+    return bit;
+}
+
+std::size_t bucket_index(std::uint64_t us) {
+    if (us < 2 * sub_bucket_count) {
+        return us;
+    }
+    auto shift = highest_bit(us) - sub_bucket_bits;
+    return shift * sub_bucket_count + (us >> shift);
+}
+
+// Upper bound of the bucket, so percentiles never under-report.
+std::uint64_t bucket_value(std::size_t index) {
+    if (index < 2 * sub_bucket_count) {
+        return index;
+    }
+    auto shift = index / sub_bucket_count - 1;
+    auto sub = index % sub_bucket_count + sub_bucket_count;
+    return ((sub + 1) << shift) - 1;
+}
+
+} //static
+
+void duration_histogram::add(std::int64_t ns) {
+    auto us = std::uint64_t(std::max<std::int64_t>(ns, 0) / 1000);
+    auto index = std::min(bucket_index(us), num_buckets - 1);
+    ++buckets[index];
+    ++total_count;
+    total_ns += ns;
+    max_ns = std::max(max_ns, ns);
+}
+
+void duration_histogram::clear() {
+    buckets.fill(0);
+    total_count = 0;
+    total_ns = 0;
+    max_ns = 0;
+}
+
+std::int64_t duration_histogram::percentile(double p) const {
+    if (total_count == 0) {
+        return 0;
+    }
+    auto target = std::uint64_t(p / 100.0 * total_count + 0.5);
+    target = std::max<std::uint64_t>(target, 1);
+    auto seen = std::uint64_t(0);
+    for (std::size_t i = 0; i < num_buckets; ++i) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return std::min<std::int64_t>(bucket_value(i) * 1000, max_ns);
+        }
+    }
+    return max_ns;
+}
+
+std::int64_t duration_histogram::max() const {
+    return max_ns;
+}
+
+std::int64_t duration_histogram::mean() const {
+    return total_count ? total_ns / std::int64_t(total_count) : 0;
+}
+
+std::uint64_t duration_histogram::count() const {
+    return total_count;
+}
+
+frame_timing::frame_timing(double budget_ms, std::size_t graph_size) :
+    budget_ns(std::int64_t(budget_ms * 1e6)),
+    graph(graph_size, 0.f)
+{}
+
+void frame_timing::add_frame(std::int64_t frame_ns, std::int64_t sim_ns, std::int64_t render_ns) {
+    frame.add(frame_ns);
+    sim.add(sim_ns);
+    render.add(render_ns);
+
+    if (frame_ns > budget_ns) {
+        ++over_budget;
+    }
+
+    if (!graph.empty()) {
+        graph[graph_head] = frame_ns / 1e6f;
+        graph_head = (graph_head + 1) % graph.size();
+    }
+}
+
+void frame_timing::reset() {
+    frame.clear();
+    sim.clear();
+    render.clear();
+    over_budget = 0;
+}
+
+const duration_histogram& frame_timing::get_frame() const {
+    return frame;
+}
+
+const duration_histogram& frame_timing::get_sim() const {
+    return sim;
+}
+
+const duration_histogram& frame_timing::get_render() const {
+    return render;
+}
+
+std::uint64_t frame_timing::get_over_budget() const {
+    return over_budget;
+}
+
+double frame_timing::get_budget_ms() const {
+    return budget_ns / 1e6;
+}
+
+void frame_timing::get_graph(std::vector<float>& out) const {
+    out.resize(graph.size());
+    std::rotate_copy(begin(graph), begin(graph) + graph_head, end(graph), begin(out));
+}
+
+bool frame_timing::write_csv_row(const std::string& filename, const std::string& label) const {
+    auto is_new = !std::ifstream(filename);
+
+    std::ofstream file (filename, std::ios::app);
+
+    if (!file) {
+        return false;
+    }
+
+    if (is_new) {
+        file << "label,frames,over_budget";
+        for (auto name : {"frame", "sim", "render"}) {
+            file << "," << name << "_p50_ms," << name << "_p95_ms," << name << "_p99_ms," << name << "_max_ms";
+        }
+        file << "\n";
+    }
+
+    file << label << "," << frame.count() << "," << over_budget;
+    for (auto hist : {&frame, &sim, &render}) {
+        file << "," << hist->percentile(50) / 1e6
+             << "," << hist->percentile(95) / 1e6
+             << "," << hist->percentile(99) / 1e6
+             << "," << hist->max() / 1e6;
+    }
+    file << "\n";
+
+    return bool(file);
+}
@@ -0,0 +1,74 @@
+#ifndef LD41_FRAME_TIMING_HPP
+#define LD41_FRAME_TIMING_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*! Log-linear histogram of durations, in the spirit of HdrHistogram.
+ *
+ * Durations are bucketed in microseconds with 16 sub-buckets per power of two,
+ * giving about 6% worst-case error up to over an hour. Fixed size, no allocation.
+ */
+class duration_histogram {
+public:
+    void add(std::int64_t ns);
+    void clear();
+
+    std::int64_t percentile(double p) const;
+    std::int64_t max() const;
+    std::int64_t mean() const;
+    std::uint64_t count() const;
+
+private:
+    static constexpr std::size_t num_buckets = 512;
+
+    std::array<std::uint32_t, num_buckets> buckets = {};
+    std::uint64_t total_count = 0;
+    std::int64_t total_ns = 0;
+    std::int64_t max_ns = 0;
+};
+
+/*! Frame pacing statistics.
+ *
+ * Tracks whole-frame, simulation and render durations, frames over budget and
+ * a rolling frame-time graph.
+ */
+class frame_timing {
+public:
+    frame_timing(double budget_ms, std::size_t graph_size);
+
+    void add_frame(std::int64_t frame_ns, std::int64_t sim_ns, std::int64_t render_ns);
+
+    /*! Clears the histograms and the over-budget count, not the graph.
+     */
+    void reset();
+
+    const duration_histogram& get_frame() const;
+    const duration_histogram& get_sim() const;
+    const duration_histogram& get_render() const;
+
+    std::uint64_t get_over_budget() const;
+    double get_budget_ms() const;
+
+    /*! Copies the graph into `out`, oldest first, in milliseconds.
+     */
+    void get_graph(std::vector<float>& out) const;
+
+    /*! Appends one row of percentiles to a CSV file, writing the header if the file is new.
+     */
+    bool write_csv_row(const std::string& filename, const std::string& label) const;
+
+private:
+    duration_histogram frame;
+    duration_histogram sim;
+    duration_histogram render;
+    std::uint64_t over_budget = 0;
+    std::int64_t budget_ns;
+    std::vector<float> graph;
+    std::size_t graph_head = 0;
+};
+
+#endif //LD41_FRAME_TIMING_HPP
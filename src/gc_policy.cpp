@@ -0,0 +1,73 @@
+#include "gc_policy.hpp"
+
+#include "profiler.hpp"
+
+#include <algorithm>
+
+namespace {
+
+std::size_t get_heap(lua_State* L) {
+    return std::size_t(lua_gc(L, LUA_GCCOUNT, 0)) * 1024 + lua_gc(L, LUA_GCCOUNTB, 0);
+}
+
+} //static
+
+gc_policy::gc_policy(lua_State* L, const settings& config) :
+    L(L),
+    config(config)
+{
+    lua_gc(L, LUA_GCSTOP, 0);
+    heap_after_cycle = get_heap(L);
+}
+
+void gc_policy::step(std::int64_t work_ns, bool idle) {
+    EMBER_PROFILE_ZONE("lua::gc");
+
+    auto start = profiler::now_ns();
+    auto heap = get_heap(L);
+
+    if (!in_cycle && !idle && heap < heap_after_cycle * config.pause) {
+        last_ns = 0;
+        return;
+    }
+
+    auto budget_ms = config.budget_ms;
+    if (idle) {
+        budget_ms = config.idle_budget_ms;
+    } else {
+        auto slack_ms = config.frame_budget_ms - work_ns / 1e6 - config.budget_ms;
+        budget_ms = std::max(budget_ms, std::min(config.idle_budget_ms, slack_ms));
+    }
+
+    auto runaway = heap > heap_after_cycle * config.runaway;
+    auto deadline = start + std::int64_t(budget_ms * 1e6);
+
+    if (runaway) {
+        EMBER_PROFILE_MARK("lua::gc_runaway");
+    }
+
+    in_cycle = true;
+
+    do {
+        if (lua_gc(L, LUA_GCSTEP, config.step_kb)) {
+            in_cycle = false;
+            ++cycles;
+            heap_after_cycle = get_heap(L);
+            break;
+        }
+    } while (runaway || profiler::now_ns() < deadline);
+
+    last_ns = profiler::now_ns() - start;
+}
+
+std::int64_t gc_policy::get_last_ns() const {
+    return last_ns;
+}
+
+std::size_t gc_policy::get_heap_bytes() const {
+    return get_heap(L);
+}
+
+std::uint64_t gc_policy::get_cycles() const {
+    return cycles;
+}
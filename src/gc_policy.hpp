@@ -0,0 +1,58 @@
+#ifndef LD41_GC_POLICY_HPP
+#define LD41_GC_POLICY_HPP
+
+#include <sol.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+/*! Time-budgeted incremental Lua garbage collection.
+ *
+ * Takes the collector off allocation-driven stepping and instead runs
+ * incremental steps once per frame until the frame's GC budget is spent, so
+ * GC cost per frame stays bounded no matter how large the live heap is. Frames
+ * with slack before the frame budget, and menus, get a larger idle budget.
+ *
+ * A new cycle only starts once the heap has grown by `pause` since the end of
+ * the last one, much like Lua's own setpause. If the heap outgrows that by far
+ * (garbage produced faster than the budget collects it), the cycle is run to
+ * completion regardless of budget.
+ */
+class gc_policy {
+public:
+    struct settings {
+        double budget_ms = 1.0;
+        double idle_budget_ms = 4.0;
+        double frame_budget_ms = 1000.0 / 60.0;
+        double pause = 1.5;
+        double runaway = 4.0;
+        int step_kb = 16;
+    };
+
+    gc_policy(lua_State* L, const settings& config);
+
+    /*! Runs this frame's collection.
+     *
+     * `work_ns` is the time the frame has spent working so far, not counting
+     * vsync waits. `idle` grants the idle budget outright, e.g. in menus.
+     */
+    void step(std::int64_t work_ns, bool idle);
+
+    /*! Time spent collecting in the last `step`.
+     */
+    std::int64_t get_last_ns() const;
+
+    std::size_t get_heap_bytes() const;
+
+    std::uint64_t get_cycles() const;
+
+private:
+    lua_State* L;
+    settings config;
+    std::int64_t last_ns = 0;
+    std::size_t heap_after_cycle = 0;
+    std::uint64_t cycles = 0;
+    bool in_cycle = false;
+};
+
+#endif //LD41_GC_POLICY_HPP
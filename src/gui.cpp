@@ -2,6 +2,8 @@
 
 #include "utility.hpp"
 
+#include <algorithm>
+
 namespace gui {
 
 glm::vec2 widget::get_size() const { return {0,0}; }
@@ -75,9 +77,9 @@ glm::vec2 get_absolute_position(gui::widget& widget) {
     return position;
 }
 
-std::vector<gui::widget*> get_descendent_stack(gui::widget& widget, glm::vec2 position) {
-    std::vector<gui::widget*> result;
-    auto parent_pos = widget.get_position();
+namespace {
+
+void push_descendent_stack(frame_vector<gui::widget*>& result, gui::widget& widget, glm::vec2 position) {
     auto parent_size = widget.get_size();
     for (auto&& child : widget.get_children()) {
         if (child->is_visible()) {
@@ -87,11 +89,17 @@ std::vector<gui::widget*> get_descendent_stack(gui::widget& widget, glm::vec2 po
             if (child_pos.y < 0) child_pos.y = parent_size.y + child_pos.y + 1.f - child_size.y;
             if (position.x >= child_pos.x && position.x < child_pos.x + child_size.x && position.y >= child_pos.y && position.y < child_pos.y + child_size.y) {
                 result.push_back(child.get());
-                auto child_stack = get_descendent_stack(*child, position - child_pos);
-                result.insert(end(result), make_move_iterator(begin(child_stack)), make_move_iterator(end(child_stack)));
+                push_descendent_stack(result, *child, position - child_pos);
             }
         }
     }
+}
+
+} //static
+
+frame_vector<gui::widget*> get_descendent_stack(gui::widget& widget, glm::vec2 position) {
+    frame_vector<gui::widget*> result;
+    push_descendent_stack(result, widget, position);
     return result;
 }
 
@@ -137,4 +145,28 @@ void panel::draw_self(render_context& renderer, glm::vec2 origin) const {
     renderer.draw_rectangle(texture, origin + get_position(), get_size());
 }
 
+const std::string& graph::get_texture() const { return texture; }
+
+void graph::set_texture(const std::string& tex) { texture = tex; }
+
+glm::vec2 graph::get_size() const { return size; }
+
+void graph::set_size(const glm::vec2& sz) { size = sz; }
+
+void graph::set_range(float max_value) { range = max_value; }
+
+std::vector<float>& graph::get_values() { return values; }
+
+void graph::draw_self(render_context& renderer, glm::vec2 origin) const {
+    if (values.empty()) return;
+    auto bar_width = size.x / values.size();
+    auto pos = origin + get_position();
+    for (auto i = 0u; i < values.size(); ++i) {
+        auto height = std::min(values[i] / range, 1.f) * size.y;
+        if (height > 0) {
+            renderer.draw_rectangle(texture, pos + glm::vec2{i * bar_width, 0}, {bar_width, height});
+        }
+    }
+}
+
 } //namespace gui
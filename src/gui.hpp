@@ -1,6 +1,8 @@
 #ifndef LD41_GUI_HPP
 #define LD41_GUI_HPP
 
+#include "frame_arena.hpp"
+
 #include <glm/glm.hpp>
 
 #include <memory>
@@ -60,7 +62,7 @@ inline widget::~widget() = default;
 
 glm::vec2 get_absolute_position(gui::widget& widget);
 
-std::vector<gui::widget*> get_descendent_stack(gui::widget& widget, glm::vec2 position);
+frame_vector<gui::widget*> get_descendent_stack(gui::widget& widget, glm::vec2 position);
 
 class screen : public widget {
 public:
@@ -110,6 +112,29 @@ private:
     glm::vec2 size = {0,0};
 };
 
+class graph : public widget {
+public:
+    const std::string& get_texture() const;
+    void set_texture(const std::string& tex);
+
+    virtual glm::vec2 get_size() const override;
+    void set_size(const glm::vec2& sz);
+
+    /*! Values at or above this fill the full height.
+     */
+    void set_range(float max_value);
+
+    std::vector<float>& get_values();
+
+    virtual void draw_self(render_context& renderer, glm::vec2 origin) const override;
+
+private:
+    std::string texture;
+    glm::vec2 size = {0,0};
+    float range = 1;
+    std::vector<float> values;
+};
+
 } //namespace gui
 
 #endif //LD41_GUI_HPP
@@ -0,0 +1,136 @@
+#include "input.hpp"
+
+namespace input {
+
+namespace {
+
+constexpr std::array<const char*, num_actions> action_names = {{
+    "left",
+    "right",
+    "up",
+    "down",
+    "shoot",
+    "number_1",
+    "number_2",
+    "number_3",
+    "number_4",
+    "number_5",
+    "number_6",
+    "number_7",
+    "number_8",
+    "number_9",
+    "number_0",
+}};
+
+std::uint32_t get_bit(action a) {
+    return std::uint32_t(1) << std::size_t(a);
+}
+
+} //static
+
+const char* get_name(action a) {
+    return action_names[std::size_t(a)];
+}
+
+action_map::action_map() {
+    bindings.fill(unbound);
+    bind(SDL_SCANCODE_LEFT, action::left);
+    bind(SDL_SCANCODE_RIGHT, action::right);
+    bind(SDL_SCANCODE_UP, action::up);
+    bind(SDL_SCANCODE_DOWN, action::down);
+    bind(SDL_SCANCODE_SPACE, action::shoot);
+    bind(SDL_SCANCODE_1, action::number_1);
+    bind(SDL_SCANCODE_2, action::number_2);
+    bind(SDL_SCANCODE_3, action::number_3);
+    bind(SDL_SCANCODE_4, action::number_4);
+    bind(SDL_SCANCODE_5, action::number_5);
+    bind(SDL_SCANCODE_6, action::number_6);
+    bind(SDL_SCANCODE_7, action::number_7);
+    bind(SDL_SCANCODE_8, action::number_8);
+    bind(SDL_SCANCODE_9, action::number_9);
+    bind(SDL_SCANCODE_0, action::number_0);
+}
+
+void action_map::bind(SDL_Scancode key, action a) {
+    bindings[key] = std::uint8_t(a);
+}
+
+void action_map::begin_frame() {
+    pressed = 0;
+    released = 0;
+}
+
+bool action_map::handle_event(const SDL_Event& event) {
+    if (event.type != SDL_KEYDOWN && event.type != SDL_KEYUP) {
+        return false;
+    }
+
+    auto scancode = event.key.keysym.scancode;
+    if (scancode < 0 || scancode >= SDL_NUM_SCANCODES || bindings[scancode] == unbound) {
+        return false;
+    }
+
+    if (event.key.repeat) {
+        return true;
+    }
+
+    auto a = action(bindings[scancode]);
+    auto bit = get_bit(a);
+
+    if (event.type == SDL_KEYDOWN) {
+        down |= bit;
+        pressed |= bit;
+        press_times[std::size_t(a)] = event.key.timestamp;
+    } else {
+        down &= ~bit;
+        released |= bit;
+    }
+
+    return true;
+}
+
+bool action_map::is_down(action a) const {
+    return down & get_bit(a);
+}
+
+bool action_map::was_pressed(action a) const {
+    return pressed & get_bit(a);
+}
+
+bool action_map::was_released(action a) const {
+    return released & get_bit(a);
+}
+
+std::uint32_t action_map::get_press_time(action a) const {
+    return press_times[std::size_t(a)];
+}
+
+} //namespace input
+
+namespace scripting {
+
+namespace {
+
+template <typename F>
+auto checked(F func) {
+    return [func](const input::action_map& map, int id) {
+        return id >= 0 && std::size_t(id) < input::num_actions && (map.*func)(input::action(id));
+    };
+}
+
+} //static
+
+template <>
+void register_type<input::action_map>(sol::table& lua) {
+    lua.new_usertype<input::action_map>("action_map",
+        "down", checked(&input::action_map::is_down),
+        "pressed", checked(&input::action_map::was_pressed),
+        "released", checked(&input::action_map::was_released));
+
+    auto actions = lua.create_named("action");
+    for (std::size_t i = 0; i < input::num_actions; ++i) {
+        actions[input::get_name(input::action(i))] = int(i);
+    }
+}
+
+} //namespace scripting
@@ -0,0 +1,95 @@
+#ifndef LD41_INPUT_HPP
+#define LD41_INPUT_HPP
+
+#include "scripting.hpp"
+#include "sdl.hpp"
+
+#include <sol.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*! Keyboard action map.
+ *
+ * Key events are mapped to actions as they are drained from the SDL queue, so
+ * a key pressed and released within one frame still registers as pressed, and
+ * presses are seen by the very next simulation step. State is a few bit sets;
+ * updating it never allocates.
+ *
+ * Lua sees the map as the `input` userdata and the action ids as the `action`
+ * table:
+ *
+ *     if input:pressed(action.shoot) then
+ */
+namespace input {
+
+enum class action : std::uint8_t {
+    left,
+    right,
+    up,
+    down,
+    shoot,
+    number_1,
+    number_2,
+    number_3,
+    number_4,
+    number_5,
+    number_6,
+    number_7,
+    number_8,
+    number_9,
+    number_0,
+    count,
+};
+
+constexpr std::size_t num_actions = std::size_t(action::count);
+
+const char* get_name(action a);
+
+class action_map {
+public:
+    /*! Creates a map with the default key bindings.
+     */
+    action_map();
+
+    void bind(SDL_Scancode key, action a);
+
+    /*! Clears the pressed and released sets; call before draining the frame's events.
+     */
+    void begin_frame();
+
+    /*! Updates the state from a key event.
+     *
+     * Returns true if the event was a key event for a bound key.
+     */
+    bool handle_event(const SDL_Event& event);
+
+    bool is_down(action a) const;
+    bool was_pressed(action a) const;
+    bool was_released(action a) const;
+
+    /*! SDL timestamp (ms) of the last press of `a`.
+     */
+    std::uint32_t get_press_time(action a) const;
+
+private:
+    static constexpr std::uint8_t unbound = 0xff;
+
+    std::array<std::uint8_t, SDL_NUM_SCANCODES> bindings;
+    std::uint32_t down = 0;
+    std::uint32_t pressed = 0;
+    std::uint32_t released = 0;
+    std::array<std::uint32_t, num_actions> press_times = {};
+};
+
+} //namespace input
+
+namespace scripting {
+
+template <>
+void register_type<input::action_map>(sol::table& lua);
+
+} //namespace scripting
+
+#endif //LD41_INPUT_HPP
@@ -0,0 +1,187 @@
+#include "lua_allocator.hpp"
+
+#include "alloc_tracker.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace {
+
+constexpr std::array<std::size_t, 8> class_sizes = {{16, 32, 48, 64, 96, 128, 192, 256}};
+
+// Size class for each multiple of 16 up to max_pooled.
+constexpr std::array<std::uint8_t, 17> class_lookup = {{0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7}};
+
+std::size_t get_class(std::size_t size) {
+    return class_lookup[(size + 15) / 16];
+}
+
+} //static
+
+lua_allocator::lua_allocator(std::size_t chunk_size) : chunk_size(chunk_size) {}
+
+void* lua_allocator::alloc(void* ud, void* ptr, std::size_t osize, std::size_t nsize) {
+    auto& self = *static_cast<lua_allocator*>(ud);
+
+    if (nsize == 0) {
+        if (ptr) {
+            self.deallocate(ptr, osize);
+        }
+        return nullptr;
+    }
+
+    // For a new block osize holds the object type, not a size.
+    if (!ptr) {
+        return self.allocate(nsize);
+    }
+
+    return self.reallocate(ptr, osize, nsize);
+}
+
+const lua_allocator::stats& lua_allocator::get_stats() const {
+    return counters;
+}
+
+void* lua_allocator::allocate(std::size_t size) {
+    auto block = size > max_pooled ? std::malloc(size) : get_block(get_class(size), true);
+    if (!block) {
+        return nullptr;
+    }
+
+    alloc_tracker::count_allocation(size);
+
+    ++counters.allocations;
+    counters.bytes_in_use += size;
+    counters.peak_bytes = std::max(counters.peak_bytes, counters.bytes_in_use);
+
+    if (size > max_pooled) {
+        counters.large_bytes += size;
+    } else {
+        counters.pooled_bytes += class_sizes[get_class(size)];
+    }
+
+    return block;
+}
+
+void lua_allocator::deallocate(void* ptr, std::size_t size) {
+    ++counters.frees;
+    counters.bytes_in_use -= size;
+
+    if (size > max_pooled) {
+        counters.large_bytes -= size;
+        std::free(ptr);
+        return;
+    }
+
+    auto index = get_class(size);
+    counters.pooled_bytes -= class_sizes[index];
+
+    auto block = static_cast<free_block*>(ptr);
+    block->next = free_lists[index];
+    free_lists[index] = block;
+}
+
+// Lua treats a failed shrink as a fatal error, so shrinks fall back to keeping the block.
+void* lua_allocator::reallocate(void* ptr, std::size_t osize, std::size_t nsize) {
+    if (osize > max_pooled && nsize > max_pooled) {
+        auto result = std::realloc(ptr, nsize);
+        if (!result) {
+            if (nsize > osize) {
+                return nullptr;
+            }
+            result = ptr;
+        }
+        if (nsize > osize) {
+            alloc_tracker::count_allocation(nsize);
+        }
+        counters.bytes_in_use += nsize - osize;
+        counters.large_bytes += nsize - osize;
+        counters.peak_bytes = std::max(counters.peak_bytes, counters.bytes_in_use);
+        return result;
+    }
+
+    if (osize <= max_pooled && nsize <= max_pooled && get_class(osize) == get_class(nsize)) {
+        counters.bytes_in_use += nsize - osize;
+        return ptr;
+    }
+
+    if (nsize > osize) {
+        auto result = allocate(nsize);
+        if (result) {
+            std::memcpy(result, ptr, osize);
+            deallocate(ptr, osize);
+        }
+        return result;
+    }
+
+    // Shrinking into a size class. A pooled block only moves to a block that is
+    // already free or left in the current chunk, so shrinking never adds a chunk.
+    auto index = get_class(nsize);
+    auto result = get_block(index, osize > max_pooled);
+
+    if (!result) {
+        // The block is big enough for the new size and is freed as one of it
+        // later. A malloc block kept this way joins the pool for good, and is
+        // never returned to malloc; that only happens when a chunk can't be had.
+        counters.bytes_in_use += nsize - osize;
+        if (osize > max_pooled) {
+            counters.large_bytes -= osize;
+        } else {
+            counters.pooled_bytes -= class_sizes[get_class(osize)];
+        }
+        counters.pooled_bytes += class_sizes[index];
+        return ptr;
+    }
+
+    std::memcpy(result, ptr, nsize);
+    deallocate(ptr, osize);
+
+    alloc_tracker::count_allocation(nsize);
+    ++counters.allocations;
+    counters.bytes_in_use += nsize;
+    counters.pooled_bytes += class_sizes[index];
+
+    return result;
+}
+
+void* lua_allocator::get_block(std::size_t index, bool grow) {
+    auto block_size = class_sizes[index];
+
+    if (auto block = free_lists[index]) {
+        free_lists[index] = block->next;
+        return block;
+    }
+
+    if (remaining < block_size && (!grow || !add_chunk())) {
+        return nullptr;
+    }
+
+    auto block = cursor;
+    cursor += block_size;
+    remaining -= block_size;
+    return block;
+}
+
+bool lua_allocator::add_chunk() {
+    auto chunk = std::unique_ptr<char, chunk_deleter>(static_cast<char*>(std::malloc(chunk_size)));
+    if (!chunk) {
+        return false;
+    }
+
+    try {
+        chunks.push_back(std::move(chunk));
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+
+    cursor = chunks.back().get();
+    remaining = chunk_size;
+    counters.chunk_bytes += chunk_size;
+    return true;
+}
+
+void lua_allocator::chunk_deleter::operator()(char* chunk) const {
+    std::free(chunk);
+}
@@ -0,0 +1,75 @@
+#ifndef LD41_LUA_ALLOCATOR_HPP
+#define LD41_LUA_ALLOCATOR_HPP
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/*! Pooled lua_Alloc for one Lua state.
+ *
+ * Blocks up to `max_pooled` bytes come from per-size-class free lists carved
+ * out of large chunks owned by the allocator; larger blocks go to malloc. Lua
+ * tells the allocator the size of every block it frees, so blocks carry no
+ * header. Chunks are only released when the allocator is destroyed, which must
+ * happen after the state using it is closed.
+ *
+ * Failed allocations return null, as Lua expects, except that shrinking a
+ * block always succeeds, if need be by leaving it where it is.
+ *
+ * Each Lua state should get its own allocator; it is not thread safe.
+ */
+class lua_allocator {
+public:
+    static constexpr std::size_t max_pooled = 256;
+
+    struct stats {
+        std::size_t allocations = 0;
+        std::size_t frees = 0;
+        std::size_t bytes_in_use = 0;
+        std::size_t peak_bytes = 0;
+        std::size_t pooled_bytes = 0; // handed out from chunks, including size class rounding
+        std::size_t chunk_bytes = 0;
+        std::size_t large_bytes = 0;
+    };
+
+    explicit lua_allocator(std::size_t chunk_size = 64 * 1024);
+
+    lua_allocator(const lua_allocator&) = delete;
+    lua_allocator& operator=(const lua_allocator&) = delete;
+
+    /*! The lua_Alloc; `ud` must point to a lua_allocator.
+     */
+    static void* alloc(void* ud, void* ptr, std::size_t osize, std::size_t nsize);
+
+    const stats& get_stats() const;
+
+private:
+    static constexpr std::size_t num_classes = 8;
+
+    struct free_block {
+        free_block* next;
+    };
+
+    struct chunk_deleter {
+        void operator()(char* chunk) const;
+    };
+
+    void* allocate(std::size_t size);
+    void deallocate(void* ptr, std::size_t size);
+    void* reallocate(void* ptr, std::size_t osize, std::size_t nsize);
+
+    /*! Takes a block of size class `index`, adding a chunk if needed and `grow` is set. Returns null if there is none.
+     */
+    void* get_block(std::size_t index, bool grow);
+    bool add_chunk();
+
+    std::size_t chunk_size;
+    std::array<free_block*, num_classes> free_lists = {};
+    std::vector<std::unique_ptr<char, chunk_deleter>> chunks;
+    char* cursor = nullptr;
+    std::size_t remaining = 0;
+    stats counters;
+};
+
+#endif //LD41_LUA_ALLOCATOR_HPP
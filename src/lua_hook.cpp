@@ -0,0 +1,68 @@
+#include "lua_hook.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Address used as the registry key of the lua_hook owning a state.
+char registry_key;
+
+} //static
+
+lua_hook::lua_hook(lua_State* L, int interval) :
+    L(L),
+    interval(std::max(interval, 1))
+{
+    lua_pushlightuserdata(L, &registry_key);
+    lua_pushlightuserdata(L, this);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
+lua_hook::~lua_hook() {
+    lua_sethook(L, nullptr, 0, 0);
+    lua_pushlightuserdata(L, &registry_key);
+    lua_pushnil(L);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+}
+
+void lua_hook::add(handler func, void* ud) {
+    handlers.push_back({func, ud});
+    update();
+}
+
+void lua_hook::remove(handler func, void* ud) {
+    handlers.erase(
+        std::remove_if(begin(handlers), end(handlers), [&](const entry& e) {
+                return e.func == func && e.ud == ud;
+            }),
+        end(handlers));
+    update();
+}
+
+int lua_hook::get_interval() const {
+    return interval;
+}
+
+void lua_hook::dispatch(lua_State* L, lua_Debug*) {
+    lua_pushlightuserdata(L, &registry_key);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    auto self = static_cast<lua_hook*>(lua_touserdata(L, -1));
+    lua_pop(L, 1);
+
+    if (!self) {
+        return;
+    }
+
+    for (std::size_t i = 0; i < self->handlers.size(); ++i) {
+        self->handlers[i].func(self->handlers[i].ud, L);
+    }
+}
+
+// The hook is only installed while someone listens.
+void lua_hook::update() {
+    if (handlers.empty()) {
+        lua_sethook(L, nullptr, 0, 0);
+    } else {
+        lua_sethook(L, &dispatch, LUA_MASKCOUNT, interval);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef LD41_LUA_HOOK_HPP
+#define LD41_LUA_HOOK_HPP
+
+#include <sol.hpp>
+
+#include <vector>
+
+/*! The count hook of a Lua state, shared by everything that needs one.
+ *
+ * Lua allows one hook per state, so the hook is installed once and calls each
+ * registered handler every `interval` instructions. Coroutines created after
+ * the hook is installed inherit it.
+ *
+ * Handlers may raise Lua errors, which unwind past the dispatcher, so neither
+ * may hold anything with a destructor at that point. Count hooks don't fire in
+ * code compiled by LuaJIT.
+ */
+class lua_hook {
+public:
+    using handler = void (*)(void* ud, lua_State* L);
+
+    lua_hook(lua_State* L, int interval);
+    ~lua_hook();
+
+    lua_hook(const lua_hook&) = delete;
+    lua_hook& operator=(const lua_hook&) = delete;
+
+    void add(handler func, void* ud);
+    void remove(handler func, void* ud);
+
+    int get_interval() const;
+
+private:
+    struct entry {
+        handler func;
+        void* ud;
+    };
+
+    static void dispatch(lua_State* L, lua_Debug* ar);
+
+    void update();
+
+    lua_State* L;
+    int interval;
+    std::vector<entry> handlers;
+};
+
+#endif //LD41_LUA_HOOK_HPP
@@ -0,0 +1,166 @@
+#include "lua_sampler.hpp"
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+lua_sampler::scope::scope(lua_sampler* sampler, const char* label, const char* detail) :
+    sampler(sampler && sampler->enabled ? sampler : nullptr)
+{
+    if (this->sampler) {
+        this->sampler->push(label, detail);
+    }
+}
+
+lua_sampler::scope::~scope() {
+    if (sampler) {
+        sampler->pop();
+    }
+}
+
+lua_sampler::lua_sampler(lua_hook& hook, double period_ms, int max_depth) :
+    hook(hook),
+    period_ns(std::max<std::int64_t>(period_ms * 1e6, 1)),
+    max_depth(std::max(max_depth, 1))
+{}
+
+lua_sampler::~lua_sampler() {
+    set_enabled(false);
+}
+
+void lua_sampler::set_enabled(bool enabled) {
+    if (enabled == this->enabled) {
+        return;
+    }
+    this->enabled = enabled;
+    if (enabled) {
+        next_sample_ns = scoped_ns + period_ns;
+        hook.add(&on_hook, this);
+    } else {
+        hook.remove(&on_hook, this);
+    }
+}
+
+bool lua_sampler::is_enabled() const {
+    return enabled;
+}
+
+void lua_sampler::reset() {
+    total = 0;
+    stacks.clear();
+    lines.clear();
+}
+
+std::uint64_t lua_sampler::get_total() const {
+    return total;
+}
+
+std::vector<lua_sampler::entry> lua_sampler::get_top(std::size_t n) const {
+    auto result = std::vector<entry>{};
+    result.reserve(lines.size());
+    for (const auto& l : lines) {
+        result.push_back({l.first, l.second});
+    }
+    n = std::min(n, result.size());
+    std::partial_sort(begin(result), begin(result) + n, end(result), [](const entry& a, const entry& b) {
+            return a.samples > b.samples;
+        });
+    result.resize(n);
+    return result;
+}
+
+bool lua_sampler::write_collapsed(const std::string& filename) const {
+    std::ofstream file (filename);
+    if (!file) {
+        return false;
+    }
+    for (const auto& s : stacks) {
+        file << s.first << ' ' << s.second << '\n';
+    }
+    return bool(file);
+}
+
+void lua_sampler::on_hook(void* ud, lua_State* L) {
+    auto self = static_cast<lua_sampler*>(ud);
+    if (self->labels.empty()) {
+        return;
+    }
+    auto scoped = self->scoped_ns + (profiler::now_ns() - self->scope_start_ns);
+    if (scoped < self->next_sample_ns) {
+        return;
+    }
+    // Time outside Lua (e.g. a long C++ call) is charged to one sample, not several.
+    self->next_sample_ns = scoped + self->period_ns;
+    self->sample(L);
+}
+
+void lua_sampler::push(const char* name, const char* detail) {
+    if (labels.empty()) {
+        scope_start_ns = profiler::now_ns();
+    }
+    labels.push_back({name, detail});
+}
+
+void lua_sampler::pop() {
+    labels.pop_back();
+    if (labels.empty()) {
+        scoped_ns += profiler::now_ns() - scope_start_ns;
+    }
+}
+
+void lua_sampler::sample(lua_State* L) {
+    EMBER_PROFILE_ZONE("lua_sampler::sample");
+
+    key.clear();
+    for (const auto& l : labels) {
+        if (!key.empty()) {
+            key += ';';
+        }
+        append_label(key, l);
+    }
+
+    auto depth = 0;
+    lua_Debug ar;
+    while (depth < max_depth && lua_getstack(L, depth, &ar)) {
+        ++depth;
+    }
+
+    auto leaf_start = key.size();
+    for (auto level = depth - 1; level >= 0; --level) {
+        lua_getstack(L, level, &ar);
+        lua_getinfo(L, "Sln", &ar);
+        key += ';';
+        leaf_start = key.size();
+        if (ar.name) {
+            key += ar.name;
+        } else {
+            key += *ar.what == 'm' ? "main" : "?";
+        }
+        key += '@';
+        key += ar.short_src;
+        if (ar.currentline >= 0) {
+            char buf[16];
+            std::snprintf(buf, sizeof(buf), ":%d", ar.currentline);
+            key += buf;
+        }
+    }
+
+    ++total;
+    ++stacks[key];
+
+    line_key.clear();
+    append_label(line_key, labels.back());
+    line_key += ' ';
+    line_key.append(key, leaf_start, std::string::npos);
+    ++lines[line_key];
+}
+
+void lua_sampler::append_label(std::string& out, const label& l) {
+    out += l.name;
+    if (l.detail) {
+        out += '.';
+        out += l.detail;
+    }
+}
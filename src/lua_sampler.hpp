@@ -0,0 +1,99 @@
+#ifndef LD41_LUA_SAMPLER_HPP
+#define LD41_LUA_SAMPLER_HPP
+
+#include "lua_hook.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*! Sampling profiler for Lua code, driven by the shared count hook.
+ *
+ * The engine marks where it calls into Lua with scopes naming the system and
+ * the script callback. Time spent inside those scopes is what gets sampled:
+ * once every `period_ms` of it, the next hook records the Lua stack under the
+ * scope labels. Each hook costs a clock read; taking a sample walks the stack
+ * and looks up one string. Lua code run outside any scope is not sampled.
+ *
+ * Samples are kept as collapsed stacks, `system;script.callback;frame;...`,
+ * with frames written `function@file:line`. Inner frames give the line that
+ * made the call and the leaf frame gives the line that was running. Stripped
+ * bytecode has no file or line information, which is why the bytecode cache
+ * keeps debug info by default.
+ */
+class lua_sampler {
+public:
+    struct entry {
+        std::string name;
+        std::uint64_t samples;
+    };
+
+    /*! Labels the Lua code run during its lifetime. A null sampler does nothing.
+     */
+    class scope {
+    public:
+        scope(lua_sampler* sampler, const char* label, const char* detail = nullptr);
+        ~scope();
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+    private:
+        lua_sampler* sampler;
+    };
+
+    lua_sampler(lua_hook& hook, double period_ms, int max_depth);
+    ~lua_sampler();
+
+    lua_sampler(const lua_sampler&) = delete;
+    lua_sampler& operator=(const lua_sampler&) = delete;
+
+    /*! Starts or stops sampling. Must not be called from inside a scope.
+     */
+    void set_enabled(bool enabled);
+    bool is_enabled() const;
+
+    void reset();
+
+    std::uint64_t get_total() const;
+
+    /*! The `n` lines with the most samples, as `script.callback function@file:line`.
+     */
+    std::vector<entry> get_top(std::size_t n) const;
+
+    /*! Writes every stack as `stack count` lines, for flamegraph.pl or speedscope.
+     */
+    bool write_collapsed(const std::string& filename) const;
+
+private:
+    struct label {
+        const char* name;
+        const char* detail;
+    };
+
+    static void on_hook(void* ud, lua_State* L);
+
+    void push(const char* name, const char* detail);
+    void pop();
+    void sample(lua_State* L);
+    void append_label(std::string& out, const label& l);
+
+    lua_hook& hook;
+    std::int64_t period_ns;
+    int max_depth;
+    bool enabled = false;
+
+    std::vector<label> labels;
+    std::int64_t scope_start_ns = 0;
+    std::int64_t scoped_ns = 0; // time spent inside scopes, not counting the open one
+    std::int64_t next_sample_ns = 0;
+
+    std::uint64_t total = 0;
+    std::unordered_map<std::string, std::uint64_t> stacks;
+    std::unordered_map<std::string, std::uint64_t> lines;
+    std::string key; // reused, so a sample only allocates for a stack not seen before
+    std::string line_key;
+};
+
+#endif //LD41_LUA_SAMPLER_HPP
@@ -0,0 +1,311 @@
+#include "lua_workers.hpp"
+
+#include "component_fields.hpp"
+#include "components.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+using ent_id = ember_database::ent_id;
+
+// Pushes a copy of the value at `index` in `from` onto `to`. Functions and userdata become nil.
+void copy_value(lua_State* from, int index, lua_State* to) {
+    index = lua_absindex(from, index);
+    switch (lua_type(from, index)) {
+        case LUA_TBOOLEAN:
+            lua_pushboolean(to, lua_toboolean(from, index));
+            break;
+        case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+            if (lua_isinteger(from, index)) {
+                lua_pushinteger(to, lua_tointeger(from, index));
+                break;
+            }
+#endif
+            lua_pushnumber(to, lua_tonumber(from, index));
+            break;
+        case LUA_TSTRING: {
+            auto len = std::size_t(0);
+            auto str = lua_tolstring(from, index, &len);
+            lua_pushlstring(to, str, len);
+            break;
+        }
+        case LUA_TTABLE:
+            lua_newtable(to);
+            lua_pushnil(from);
+            while (lua_next(from, index)) {
+                copy_value(from, -2, to);
+                copy_value(from, -1, to);
+                lua_rawset(to, -3);
+                lua_pop(from, 1);
+            }
+            break;
+        default:
+            lua_pushnil(to);
+            break;
+    }
+}
+
+int view_get_field(lua_State* L) {
+    auto& view = sol::stack::get<deferred_database&>(L, 1);
+    auto eid = sol::stack::get<ent_id>(L, 2);
+    return component_fields::push_field(L, view.get_database(), eid, lua_tointeger(L, 3));
+}
+
+int view_has_type(lua_State* L) {
+    auto& view = sol::stack::get<deferred_database&>(L, 1);
+    auto eid = sol::stack::get<ent_id>(L, 2);
+    auto& db = view.get_database();
+    auto type = lua_type(L, 3) == LUA_TNUMBER ? lua_tointeger(L, 3) : -1;
+    lua_pushboolean(L, component_fields::has_type(db, eid, type));
+    return 1;
+}
+
+} //static
+
+deferred_database::deferred_database(ember_database& db, command_buffer& commands, std::vector<deferred_field_write>& field_writes) :
+    db(&db),
+    commands(&commands),
+    field_writes(&field_writes)
+{}
+
+ember_database& deferred_database::get_database() const {
+    return *db;
+}
+
+command_buffer& deferred_database::get_commands() const {
+    return *commands;
+}
+
+std::vector<deferred_field_write>& deferred_database::get_field_writes() const {
+    return *field_writes;
+}
+
+namespace scripting {
+
+template <>
+void register_type<deferred_database>(sol::table& lua) {
+    lua.new_usertype<deferred_database>("deferred_database",
+        "exists", [](deferred_database& view, ent_id eid) {
+            return view.get_database().exists(eid);
+        },
+        "has_component", [](deferred_database& view, ent_id eid, sol::table com_type) {
+            return com_type["_has_component"](std::ref(view.get_database()), eid);
+        },
+        "get_component", [](deferred_database& view, ent_id eid, sol::table com_type) {
+            return com_type["_copy_component"](std::ref(view.get_database()), eid);
+        },
+        "create_component", [](deferred_database& view, ent_id eid, sol::userdata com) {
+            return com["_defer_create_component"](std::ref(view.get_commands()), eid, com);
+        },
+        "destroy_component", [](deferred_database& view, ent_id eid, sol::table com_type) {
+            return com_type["_defer_destroy_component"](std::ref(view.get_commands()), eid);
+        },
+        "destroy_entity", [](deferred_database& view, ent_id eid) {
+            view.get_commands().destroy_entity(eid);
+        },
+        "set_field", [](deferred_database& view, ent_id eid, lua_Integer token, lua_Number value) {
+            view.get_field_writes().push_back({eid, token, value});
+        },
+        "get_field", &view_get_field,
+        "has_type", &view_has_type);
+}
+
+} //namespace scripting
+
+struct lua_workers::worker {
+    worker(ember_database& entities, const bytecode_cache& bytecode);
+
+#ifndef SOL_LUAJIT
+    lua_allocator memory;
+#endif
+    sol::state lua;
+    bytecode_cache bytecode;
+    command_buffer commands;
+    std::vector<deferred_field_write> field_writes;
+    deferred_database view;
+    std::unordered_map<std::string, script> scripts;
+};
+
+lua_workers::worker::worker(ember_database& entities, const bytecode_cache& bytecode) :
+#ifndef SOL_LUAJIT
+    lua(sol::detail::default_at_panic, &lua_allocator::alloc, &memory),
+#endif
+    bytecode(bytecode),
+    view(entities, commands, field_writes)
+{
+    lua.open_libraries(sol::lib::base, sol::lib::math, sol::lib::string, sol::lib::table);
+
+    auto global_table = sol::table(lua.globals());
+    scripting::register_type<ember_database>(global_table);
+    scripting::register_type<deferred_database>(global_table);
+
+    auto component_table = lua.create_named_table("component");
+    component::register_components(component_table);
+
+    lua["entities"] = std::ref(view);
+}
+
+lua_workers::lua_workers(ember_database& entities, std::size_t num_states, std::size_t min_batch, const bytecode_cache& bytecode) :
+    entities(entities),
+    min_batch(std::max<std::size_t>(min_batch, 1)),
+    pool(num_states > 0 ? num_states - 1 : 0)
+{
+    workers.reserve(num_states);
+    for (std::size_t i = 0; i < num_states; ++i) {
+        workers.push_back(std::make_unique<worker>(entities, bytecode));
+    }
+}
+
+lua_workers::~lua_workers() = default;
+
+void lua_workers::set_global(const std::string& name, const sol::object& value) {
+    auto L = value.lua_state();
+    value.push();
+    for (auto& w : workers) {
+        auto WL = w->lua.lua_state();
+        copy_value(L, -1, WL);
+        lua_setglobal(WL, name.c_str());
+    }
+    lua_pop(L, 1);
+}
+
+void lua_workers::submit(const std::string& script, const std::vector<ent_id>& eids) {
+    if (!eids.empty()) {
+        jobs.push_back({&script, &eids});
+    }
+}
+
+void lua_workers::run(double delta) {
+    if (jobs.empty() || workers.empty()) {
+        jobs.clear();
+        return;
+    }
+
+    EMBER_PROFILE_ZONE("lua_workers::run");
+
+    auto active = std::size_t(1);
+    for (auto& j : jobs) {
+        active = std::max(active, std::min(workers.size(), (j.eids->size() + min_batch - 1) / min_batch));
+    }
+
+    for (std::size_t i = 1; i < active; ++i) {
+        pool.submit([this, i, delta]{ run_worker(i, delta); });
+    }
+    run_worker(0, delta);
+    pool.wait();
+
+    {
+        EMBER_PROFILE_ZONE("lua_workers::flush");
+        for (std::size_t i = 0; i < active; ++i) {
+            auto& w = *workers[i];
+            w.commands.flush(entities);
+            for (const auto& write : w.field_writes) {
+                if (entities.exists(write.eid)) {
+                    component_fields::write_field(entities, write.eid, write.token, write.value);
+                }
+            }
+            w.field_writes.clear();
+        }
+    }
+
+    jobs.clear();
+}
+
+std::size_t lua_workers::size() const {
+    return workers.size();
+}
+
+std::size_t lua_workers::memory_used() const {
+    auto total = std::size_t(0);
+    for (auto& w : workers) {
+        total += w->lua.memory_used();
+    }
+    return total;
+}
+
+lua_workers::script& lua_workers::get_script(worker& w, const std::string& name) {
+    auto iter = w.scripts.find(name);
+    if (iter != end(w.scripts)) {
+        return iter->second;
+    }
+
+    auto& scr = w.scripts[name];
+
+    try {
+        auto env = sol::environment(w.lua, sol::create, w.lua.globals());
+        auto chunk = w.bytecode.load(w.lua, name);
+        env.set_on(chunk);
+        auto result = chunk();
+        if (!result.valid()) {
+            sol::error err = result;
+            throw err;
+        }
+        sol::object update = env["update"];
+        sol::object update_all = env["update_all"];
+        if (update.get_type() == sol::type::function) {
+            scr.update = update.as<sol::protected_function>();
+        }
+        if (update_all.get_type() == sol::type::function) {
+            scr.update_all = update_all.as<sol::protected_function>();
+            scr.batch = sol::table(w.lua, sol::create);
+        }
+        scr.environment = std::move(env);
+    } catch (const sol::error& e) {
+        // Left without callbacks, so it isn't retried every frame.
+        std::cerr << "ERROR: Loading " << name << " on a worker: " << e.what() << std::endl;
+    }
+
+    return scr;
+}
+
+void lua_workers::run_worker(std::size_t index, double delta) {
+    EMBER_PROFILE_ZONE("lua_workers::worker");
+
+    auto& w = *workers[index];
+
+    for (auto& j : jobs) {
+        auto& eids = *j.eids;
+        auto shards = std::min(workers.size(), (eids.size() + min_batch - 1) / min_batch);
+        if (index >= shards) {
+            continue;
+        }
+
+        auto shard_size = (eids.size() + shards - 1) / shards;
+        auto first = index * shard_size;
+        auto last = std::min(eids.size(), first + shard_size);
+        if (first >= last) {
+            continue;
+        }
+
+        auto& scr = get_script(w, *j.script);
+
+        if (scr.update_all.valid()) {
+            auto count = std::size_t(0);
+            for (auto i = first; i < last; ++i) {
+                scr.batch[++count] = eids[i];
+            }
+            for (auto i = count + 1; i <= scr.batch_size; ++i) {
+                scr.batch[i] = sol::nil;
+            }
+            scr.batch_size = count;
+
+            auto result = scr.update_all(scr.batch, delta, count);
+            if (!result.valid()) {
+                sol::error err = result;
+                std::cerr << "ERROR: " << *j.script << ".update_all (worker " << index << "): " << err.what() << std::endl;
+            }
+        } else if (scr.update.valid()) {
+            for (auto i = first; i < last; ++i) {
+                auto result = scr.update(eids[i], delta);
+                if (!result.valid()) {
+                    sol::error err = result;
+                    std::cerr << "ERROR: " << *j.script << ".update (worker " << index << "): " << err.what() << std::endl;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef LD41_LUA_WORKERS_HPP
+#define LD41_LUA_WORKERS_HPP
+
+#include "bytecode_cache.hpp"
+#include "command_buffer.hpp"
+#include "entities.hpp"
+#include "lua_allocator.hpp"
+#include "thread_pool.hpp"
+
+#include <sol.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*! A `set_field` made on a worker, applied at the sync point.
+ */
+struct deferred_field_write {
+    ember_database::ent_id eid;
+    lua_Integer token;
+    lua_Number value;
+};
+
+/*! The database as seen from a worker Lua state.
+ *
+ * Bound as `entities` in worker states. Reads go straight to the database,
+ * which nothing else touches while workers run. Structural changes go to the
+ * worker's command buffer and field writes to a plain list of writes, so the
+ * hot `set_field` doesn't allocate a command each; both are applied at the
+ * sync point, the structural changes first.
+ */
+class deferred_database {
+public:
+    deferred_database(ember_database& db, command_buffer& commands, std::vector<deferred_field_write>& field_writes);
+
+    ember_database& get_database() const;
+    command_buffer& get_commands() const;
+    std::vector<deferred_field_write>& get_field_writes() const;
+
+private:
+    ember_database* db;
+    command_buffer* commands;
+    std::vector<deferred_field_write>* field_writes;
+};
+
+namespace scripting {
+
+template <>
+void register_type<deferred_database>(sol::table& lua);
+
+} //namespace scripting
+
+/*! Extra Lua states that run script updates in parallel.
+ *
+ * Scripts opt in by setting the global `parallel = true`. Their entities are
+ * split across the worker states, each with its own copy of every script,
+ * and updated concurrently. Only `update` and `update_all` run on workers;
+ * the other callbacks still run on the main state.
+ *
+ * In a worker state, `entities` is a deferred_database. It offers exists,
+ * has_component, has_type, get_field, get_component (which returns a copy),
+ * set_field, create_component, destroy_component and destroy_entity. Writes
+ * take effect after every worker has finished, in worker order (and within a
+ * worker, field writes after structural changes), so results don't depend on
+ * thread timing. The other globals scripts see are the standard libraries,
+ * `component` and whatever was copied in with set_global().
+ */
+class lua_workers {
+public:
+    using ent_id = ember_database::ent_id;
+
+    /*! `bytecode` is copied for each state; it should not write to the cache.
+     *
+     * Batches smaller than `min_batch` per state are spread over fewer states.
+     */
+    lua_workers(ember_database& entities, std::size_t num_states, std::size_t min_batch, const bytecode_cache& bytecode);
+    ~lua_workers();
+
+    /*! Deep copies a value made of tables, strings, numbers and booleans into a global of every worker state.
+     */
+    void set_global(const std::string& name, const sol::object& value);
+
+    /*! Queues `eids` to be updated by `script` in the next run(). `eids` must stay alive until then.
+     */
+    void submit(const std::string& script, const std::vector<ent_id>& eids);
+
+    /*! Runs every queued batch and applies the resulting commands.
+     */
+    void run(double delta);
+
+    std::size_t size() const;
+
+    std::size_t memory_used() const;
+
+private:
+    struct script {
+        sol::environment environment;
+        sol::protected_function update;
+        sol::protected_function update_all;
+        sol::table batch;
+        std::size_t batch_size = 0;
+    };
+
+    struct worker;
+
+    struct job {
+        const std::string* script;
+        const std::vector<ent_id>* eids;
+    };
+
+    script& get_script(worker& w, const std::string& name);
+    void run_worker(std::size_t index, double delta);
+
+    ember_database& entities;
+    std::size_t min_batch;
+    std::vector<std::unique_ptr<worker>> workers;
+    std::vector<job> jobs;
+    thread_pool pool;
+};
+
+#endif //LD41_LUA_WORKERS_HPP
@@ -3,10 +3,30 @@
 #include "emberjs/config.hpp"
 
 #include "utility.hpp"
+#include "component_fields.hpp"
 #include "components.hpp"
+#include "alloc_tracker.hpp"
+#include "behaviours.hpp"
+#include "bytecode_cache.hpp"
+#include "flight_recorder.hpp"
 #include "font.hpp"
+#include "frame_arena.hpp"
+#include "frame_timing.hpp"
+#include "gc_policy.hpp"
 #include "gui.hpp"
+#include "input.hpp"
+#include "lua_allocator.hpp"
+#include "lua_hook.hpp"
+#include "lua_sampler.hpp"
+#include "lua_workers.hpp"
+#include "memory_report.hpp"
+#include "prefabs.hpp"
+#include "profiler.hpp"
 #include "resource_cache.hpp"
+#include "scheduler.hpp"
+#include "script_budget.hpp"
+#include "script_registry.hpp"
+#include "script_tasks.hpp"
 #include "sushi_renderer.hpp"
 #include "systems.hpp"
 
@@ -32,6 +52,7 @@
 #include <stdexcept>
 #include <string>
 #include <cstddef>
+#include <cstdio>
 #include <cmath>
 #include <functional>
 #include <memory>
@@ -61,8 +82,10 @@ auto vectorify(Ts&&... ts) {
 }
 
 std::function<void()>* loop;
+std::function<void()>* end_frame;
 void main_loop() try {
     (*loop)();
+    (*end_frame)();
 } catch (std::exception& e) {
     std::cerr << "Exception: " << e.what() << std::endl;
     std::terminate();
@@ -77,7 +100,14 @@ int main(int argc, char* argv[]) try {
 
     std::cout << "Creating Lua state..." << std::endl;
 
+#ifdef SOL_LUAJIT
+    // LuaJIT on x64 without GC64 cannot use a custom allocator.
     sol::state lua;
+#else
+    // Declared first so it outlives the state.
+    lua_allocator lua_memory;
+    sol::state lua (sol::detail::default_at_panic, &lua_allocator::alloc, &lua_memory);
+#endif
     lua.open_libraries(sol::lib::base, sol::lib::math, sol::lib::string, sol::lib::table);
 
     auto nlohmann_table = lua.create_named_table("component");
@@ -91,7 +121,14 @@ int main(int argc, char* argv[]) try {
     auto component_table = lua.create_named_table("component");
     component::register_components(component_table);
 
-    auto input_table = lua.create_named_table("input");
+    auto fields_table = lua.create_named_table("fields");
+    component_fields::register_types(fields_table, component_table, component::all{});
+    component_fields::open_ffi(lua);
+
+    auto actions = input::action_map{};
+
+    scripting::register_type<input::action_map>(global_table);
+    lua["input"] = std::ref(actions);
 
     std::cout << "Initializing soloud..." << std::endl;
 
@@ -100,50 +137,32 @@ int main(int argc, char* argv[]) try {
 
     std::cout << "Creating caches..." << std::endl;
 
-    auto json_to_lua = [&](const nlohmann::json& json, auto& json_to_lua) -> sol::object {
-        using value_t = nlohmann::json::value_t;
-        switch (json.type()) {
-            case value_t::null:
-                return sol::make_object(lua, sol::nil);
-            case value_t::object: {
-                auto obj = lua.create_table();
-                for (auto it = json.begin(); it != json.end(); ++it) {
-                    obj[it.key()] = json_to_lua(it.value(), json_to_lua);
-                }
-                return obj;
-            }
-            case value_t::array: {
-                auto obj = lua.create_table();
-                for (auto i = 0; i < json.size(); ++i) {
-                    obj[i+1] = json_to_lua(json[i], json_to_lua);
-                }
-                return obj;
-            }
-            case value_t::string:
-                return sol::make_object(lua, json.get<std::string>());
-            case value_t::boolean:
-                return sol::make_object(lua, json.get<bool>());
-            case value_t::number_integer:
-                return sol::make_object(lua, json.get<int>());
-            case value_t::number_unsigned:
-                return sol::make_object(lua, json.get<unsigned>());
-            case value_t::number_float:
-                return sol::make_object(lua, json.get<double>());
-            default:
-                return sol::make_object(lua, sol::nil);
-        }
-    };
-
     std::cout << "Loading config..." << std::endl;
 
     auto config = emberjs::get_config();
 
+    const auto& bytecode_config = config.value("lua_bytecode", nlohmann::json::object());
+
+    auto bytecode = bytecode_cache("data/scripts/", "data/bytecode/",
+        bytecode_config.value("write", true),
+        bytecode_config.value("strip", false));
+
+    // Build step: compile the named scripts into the bytecode cache and exit.
+    if (argc > 1 && argv[1] == "--precompile-scripts"s) {
+        auto success = true;
+        for (int i = 2; i < argc; ++i) {
+            success = bytecode.compile(lua, argv[i]) && success;
+        }
+        std::cout << "Precompiled " << bytecode.get_stats().written << " of " << argc - 2 << " scripts." << std::endl;
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     const auto display_width = int(config["display"]["width"]);
     const auto display_height = int(config["display"]["height"]);
     const auto aspect_ratio = float(display_width) / float(display_height);
 
     auto json_to_lua_rec = [&](const nlohmann::json& json) {
-        return json_to_lua(json, json_to_lua);
+        return scripting::json_to_lua(lua, json);
     };
 
     auto mesh_cache = resource_cache<sushi::static_mesh, std::string>([](const std::string& name){
@@ -174,10 +193,101 @@ int main(int argc, char* argv[]) try {
 
     auto environment_cache = resource_cache<sol::environment, std::string>{[&](const std::string& name) {
             auto env = sol::environment(lua, sol::create, lua.globals());
-            lua.safe_script_file("data/scripts/"+name+".lua", env);
+            auto chunk = bytecode.load(lua, name);
+            env.set_on(chunk);
+            auto result = chunk();
+            if (!result.valid()) {
+                sol::error err = result;
+                throw err;
+            }
             return env;
         }};
 
+    auto scripts = script_registry(environment_cache);
+
+    const auto& budget_config = config.value("script_budget", nlohmann::json::object());
+
+    auto read_limits = [](const nlohmann::json& json, script_budget::limits limits) {
+        limits.call_instructions = json.value("call_instructions", limits.call_instructions);
+        limits.call_ms = json.value("call_ms", limits.call_ms);
+        limits.frame_ms = json.value("frame_ms", limits.frame_ms);
+        limits.defer = json.value("defer", limits.defer);
+        return limits;
+    };
+
+    auto lua_hooks = lua_hook(lua, budget_config.value("hook_interval", 1000));
+
+    auto budget_defaults = read_limits(budget_config.value("default", nlohmann::json::object()), script_budget::limits{});
+    auto budget = script_budget(lua_hooks, budget_defaults);
+
+    const auto& budget_scripts = budget_config.value("scripts", nlohmann::json::object());
+    for (auto it = budget_scripts.begin(); it != budget_scripts.end(); ++it) {
+        budget.set_limits(it.key(), read_limits(it.value(), budget_defaults));
+    }
+
+    scripts.set_budget(budget);
+
+    const auto& sampler_config = config.value("lua_sampler", nlohmann::json::object());
+    const auto sampler_output = sampler_config.value("output", "ld41_lua_stacks.txt"s);
+
+    const auto sampler_enabled = sampler_config.value("enabled", false);
+
+    auto sampler = lua_sampler(lua_hooks, sampler_config.value("period_ms", 1.0), sampler_config.value("max_depth", 16));
+    sampler.set_enabled(sampler_enabled);
+
+    scripts.set_sampler(sampler);
+
+    lua["script_stats"] = [&](sol::this_state s) {
+        auto table = sol::state_view(s).create_table();
+        for (const auto& e : budget.get_entries()) {
+            auto stats = table.create_named(e.name);
+            stats["calls"] = e.calls;
+            stats["instructions"] = e.instructions;
+            stats["ms"] = e.total_ns / 1e6;
+            stats["max_ms"] = e.max_ns / 1e6;
+            stats["aborted"] = e.aborted;
+            stats["frame_overruns"] = e.frame_overruns;
+            stats["deferred"] = e.deferred;
+        }
+        return table;
+    };
+
+    auto tasks = script_tasks(lua, entities, scripts);
+
+    auto natives = behaviour_registry(entities);
+    behaviours::register_all(natives);
+
+    if (config.value("native_behaviours", true)) {
+        scripts.set_natives(natives);
+    }
+
+    const auto& workers_config = config.value("lua_workers", nlohmann::json::object());
+
+    auto workers = lua_workers(entities,
+        workers_config.value("states", 0),
+        workers_config.value("min_batch", 32),
+        bytecode_cache("data/scripts/", "data/bytecode/", false, bytecode_config.value("strip", false)));
+
+    if (workers.size() > 0) {
+        workers.set_global("fields", lua["fields"]);
+        scripts.set_workers(workers);
+    }
+
+    // Loads every script named by a `script` component in `json`, so the first spawn doesn't compile it mid-frame.
+    auto preload_scripts = [&](const nlohmann::json& json, auto& preload_scripts) -> void {
+        if (json.is_object()) {
+            auto iter = json.find("script");
+            if (iter != json.end() && iter->is_object() && iter->count("name")) {
+                scripts.get_handle((*iter)["name"].get<std::string>());
+            }
+        }
+        if (json.is_structured()) {
+            for (const auto& value : json) {
+                preload_scripts(value, preload_scripts);
+            }
+        }
+    };
+
     auto sfx_cache = resource_cache<SoLoud::Wav, std::string>{[&](const std::string& name) {
         auto wav = std::make_shared<SoLoud::Wav>();
         wav->load(("data/sound/sfx/"+name+".wav").c_str());
@@ -214,6 +324,7 @@ int main(int argc, char* argv[]) try {
     };
 
     lua["set_game_state"] = set_game_state;
+    natives.get_context().set_game_state = set_game_state;
 
     auto play_sfx = [&](const std::string& name) {
         auto wav_ptr = sfx_cache.get(name);
@@ -221,6 +332,8 @@ int main(int argc, char* argv[]) try {
         soloud.play(*wav_ptr);
     };
 
+    natives.get_context().play_sfx = play_sfx;
+
     auto play_music = [&](const std::string& name) {
         auto wav_ptr = music_cache.get(name);
         soloud.stopAudioSource(*wav_ptr);
@@ -230,17 +343,93 @@ int main(int argc, char* argv[]) try {
 
     auto current_level = "level1"s;
 
+    auto build_memory_report = [&]{
+        auto report = memory_report{};
+        report.add_components(entities, component::all{});
+        report.add_cache("textures", texture_cache);
+        report.add_cache("meshes", mesh_cache);
+        report.add_cache("animations", animation_cache);
+        report.add_cache("fonts", font_cache);
+        report.add_cache("sfx", sfx_cache);
+        report.add_cache("music", music_cache);
+        report.add_cache("stages", tile_level_cache);
+        report.add("lua", "heap", lua.memory_used());
+        report.add("lua", "workers", workers.memory_used());
+#ifndef SOL_LUAJIT
+        const auto& lua_stats = lua_memory.get_stats();
+        report.add("lua", "pool slack", lua_stats.chunk_bytes - lua_stats.pooled_bytes);
+#endif
+        return report;
+    };
+
+    lua["memory_report"] = [&](sol::this_state s) {
+        auto table = sol::state_view(s).create_table();
+        for (const auto& total : build_memory_report().get_totals()) {
+            table[total.category] = total.bytes;
+        }
+        return table;
+    };
+
+    auto set_path_logic = [&](const std::string& level) {
+        auto path = *path_logic_cache.get(level + "pathlogic");
+        lua["path_logic"] = path;
+        workers.set_global("path_logic", path);
+        auto& native_path = natives.get_context().path_logic;
+        native_path.clear();
+        for (std::size_t i = 1; i <= path.size(); ++i) {
+            native_path.push_back({path[i]["x"].get<float>(), path[i]["y"].get<float>()});
+        }
+    };
+
+    const auto native_stage_loader = config.value("native_stage_loader", true);
+
+    // Creates stage entities straight from the stage JSON. Only the components
+    // it can't map onto component values go through loader.lua.
     auto load_stage = [&](const std::string& name) {
+        EMBER_PROFILE_ZONE("load_stage");
+        auto start_ns = profiler::now_ns();
         entities.visit([&](ember_database::ent_id eid) {
                 entities.destroy_entity(eid);
             });
+        tasks.clear();
+        auto clear_ns = profiler::now_ns();
         current_level = name;
-        std::ifstream file ("data/stages/" + name + ".json");
-        nlohmann::json json;
-        file >> json;
+        auto stage = tile_level_cache.get(name);
+        const auto& stage_entities = stage->at("entities");
+        auto parse_ns = profiler::now_ns();
+        preload_scripts(stage_entities, preload_scripts);
+        auto scripts_ns = profiler::now_ns();
         auto loader_ptr = environment_cache.get("system/loader");
-        (*loader_ptr)["load_world"](json_to_lua_rec(json["entities"]));
-        lua["path_logic"] = *path_logic_cache.get(current_level + "pathlogic");
+        auto num_lua = std::size_t(0);
+        if (native_stage_loader) {
+            sol::protected_function load_components = (*loader_ptr)["load_components"];
+            for (const auto& ent : stage_entities) {
+                auto eid = entities.create_entity();
+                auto rest = create_components(entities, eid, ent);
+                if (!rest.is_null()) {
+                    auto result = load_components(eid, json_to_lua_rec(rest));
+                    if (!result.valid()) {
+                        sol::error err = result;
+                        std::cerr << "ERROR: Stage " << name << ": " << err.what() << std::endl;
+                    }
+                    ++num_lua;
+                }
+            }
+        } else {
+            (*loader_ptr)["load_world"](json_to_lua_rec(stage_entities));
+            num_lua = stage_entities.size();
+        }
+        auto entities_ns = profiler::now_ns();
+        set_path_logic(current_level);
+        auto path_ns = profiler::now_ns();
+        char times[160];
+        std::snprintf(times, sizeof(times), "%.2fms (clear %.2f, parse %.2f, scripts %.2f, entities %.2f, path %.2f)",
+            (path_ns - start_ns) / 1e6, (clear_ns - start_ns) / 1e6, (parse_ns - clear_ns) / 1e6,
+            (scripts_ns - parse_ns) / 1e6, (entities_ns - scripts_ns) / 1e6, (path_ns - entities_ns) / 1e6);
+        const auto& bytecode_stats = bytecode.get_stats();
+        std::clog << "Loaded stage " << name << " in " << times << ", " << stage_entities.size() << " entities (" << num_lua << " through Lua)"
+                  << " (scripts: " << bytecode_stats.hits << " cached, " << bytecode_stats.compiled << " compiled), ";
+        build_memory_report().print(std::clog);
     };
 
     auto load_next_stage = [&]() {
@@ -258,6 +447,17 @@ int main(int argc, char* argv[]) try {
         return eid;
     };
 
+    // Towers and enemies, spawned without going through JSON or the Lua loader.
+    prefab_registry prefabs;
+
+    auto spawn_prefab = [&](const std::string& name, sol::optional<float> x, sol::optional<float> y) {
+        auto eid = prefabs.spawn(entities, name);
+        if (x && y) {
+            entities.create_component(eid, component::position{*x, *y});
+        }
+        return eid;
+    };
+
     auto get_tile_at = [&](int x, int y)->int {
           auto json = *tile_level_cache.get(current_level);
           for(auto& tile : json["tileset"]){
@@ -272,8 +472,9 @@ int main(int argc, char* argv[]) try {
     lua["play_sfx"] = play_sfx;
     lua["play_music"] = play_music;
     lua["entity_from_json"] = entity_from_json;
+    lua["spawn_prefab"] = spawn_prefab;
     lua["get_tile_at"] = get_tile_at;
-    lua["path_logic"] = *path_logic_cache.get(current_level + "pathlogic");
+    set_path_logic(current_level);
 
     std::cout << "Initializing SDL..." << std::endl;
 
@@ -430,6 +631,7 @@ int main(int argc, char* argv[]) try {
     struct tower_info {
         std::shared_ptr<gui::panel> panel;
         nlohmann::json json;
+        std::string prefab;
     };
 
     auto tower_panels = std::vector<tower_info>{};
@@ -459,7 +661,7 @@ int main(int argc, char* argv[]) try {
         panel->add_child(tower_image);
         panel->add_child(number_label);
 
-        tower_panels.push_back({panel, json});
+        tower_panels.push_back({panel, json, image});
     };
 
     {
@@ -470,9 +672,141 @@ int main(int argc, char* argv[]) try {
         for (auto& tower : json) {
             add_tower("towers/"+tower["name"].get<std::string>(), tower["template"]);
         }
+
+        prefabs.add_all("towers/", json);
+
+        preload_scripts(json, preload_scripts);
     }
 
+    auto profiler_labels = std::vector<std::shared_ptr<gui::label>>{};
+
+    for (int i = 0; i < 8; ++i) {
+        auto label = std::make_shared<gui::label>();
+        label->set_position({-1, -14 - 9*i});
+        label->set_font("LiberationSans-Regular");
+        label->set_size(renderer, 8);
+        label->set_text(renderer, "");
+        label->set_color({1,0,1,1});
+        profiler_labels.push_back(label);
+    }
+
+    auto show_profiler = false;
+
+    auto update_profiler_overlay = [&]{
+        const auto& stats = profiler::get_frame_stats();
+        for (auto i = 0u; i < profiler_labels.size(); ++i) {
+            auto& label = profiler_labels[i];
+            if (show_profiler && i < stats.size()) {
+                char text[96];
+                if (alloc_tracker::get_attribution()) {
+                    auto allocs = alloc_tracker::get_frame_allocs(stats[i].name);
+                    std::snprintf(text, sizeof(text), "%s %.2fms x%d %llua", stats[i].name, stats[i].total_ns / 1e6, stats[i].count, (unsigned long long)allocs.count);
+                } else {
+                    std::snprintf(text, sizeof(text), "%s %.2fms x%d", stats[i].name, stats[i].total_ns / 1e6, stats[i].count);
+                }
+                label->set_text(renderer, text);
+                label->show();
+            } else {
+                label->hide();
+            }
+        }
+    };
+
+    auto memory_labels = std::vector<std::shared_ptr<gui::label>>{};
+
+    for (int i = 0; i < 8; ++i) {
+        auto label = std::make_shared<gui::label>();
+        label->set_position({1, -14 - 9*i});
+        label->set_font("LiberationSans-Regular");
+        label->set_size(renderer, 8);
+        label->set_text(renderer, "");
+        label->set_color({0,1,1,1});
+        memory_labels.push_back(label);
+    }
+
+    auto show_memory = false;
+
+    auto update_memory_overlay = [&]{
+        auto totals = show_memory ? build_memory_report().get_totals() : std::vector<memory_report::entry>{};
+        for (auto i = 0u; i < memory_labels.size(); ++i) {
+            auto& label = memory_labels[i];
+            if (i < totals.size()) {
+                char text[96];
+                std::snprintf(text, sizeof(text), "%s %.1fKiB", totals[i].category.c_str(), totals[i].bytes / 1024.0);
+                label->set_text(renderer, text);
+                label->show();
+            } else {
+                label->hide();
+            }
+        }
+    };
+
+    auto lua_labels = std::vector<std::shared_ptr<gui::label>>{};
+
+    for (int i = 0; i < 8; ++i) {
+        auto label = std::make_shared<gui::label>();
+        label->set_position({1, -86 - 9*i});
+        label->set_font("LiberationSans-Regular");
+        label->set_size(renderer, 8);
+        label->set_text(renderer, "");
+        label->set_color({1,1,0,1});
+        lua_labels.push_back(label);
+    }
+
+    auto show_lua = false;
+
+    auto update_lua_overlay = [&]{
+        auto top = show_lua ? sampler.get_top(lua_labels.size()) : std::vector<lua_sampler::entry>{};
+        auto total = std::max<std::uint64_t>(sampler.get_total(), 1);
+        for (auto i = 0u; i < lua_labels.size(); ++i) {
+            auto& label = lua_labels[i];
+            if (i < top.size()) {
+                char text[128];
+                std::snprintf(text, sizeof(text), "%.1f%% %s", 100.0 * top[i].samples / total, top[i].name.c_str());
+                label->set_text(renderer, text);
+                label->show();
+            } else {
+                label->hide();
+            }
+        }
+    };
+
+    const auto& timing_config = config.value("frame_timing", nlohmann::json::object());
+
+    auto frame_timer = frame_timing(timing_config.value("budget_ms", 1000.0 / 60.0), 120);
+    const auto timing_dump_interval = timing_config.value("dump_interval", 0.0);
+    const auto timing_dump_file = timing_config.value("dump_file", "ld41_frame_timing.csv"s);
+
+    const auto& gc_config = config.value("lua_gc", nlohmann::json::object());
+
+    auto gc_settings = gc_policy::settings{};
+    gc_settings.budget_ms = gc_config.value("budget_ms", gc_settings.budget_ms);
+    gc_settings.idle_budget_ms = gc_config.value("idle_budget_ms", gc_settings.idle_budget_ms);
+    gc_settings.pause = gc_config.value("pause", gc_settings.pause);
+    gc_settings.runaway = gc_config.value("runaway", gc_settings.runaway);
+    gc_settings.step_kb = gc_config.value("step_kb", gc_settings.step_kb);
+    gc_settings.frame_budget_ms = frame_timer.get_budget_ms();
+
+    auto gc = gc_policy(lua.lua_state(), gc_settings);
+
+    auto frame_graph = std::make_shared<gui::graph>();
+    frame_graph->set_position({0,40});
+    frame_graph->set_size({120,40});
+    frame_graph->set_texture("powermeter");
+    frame_graph->set_range(frame_timer.get_budget_ms() * 2);
+
     root_widget.add_child(framerate_stamp);
+    root_widget.add_child(frame_graph);
+
+    for (const auto& label : profiler_labels) {
+        root_widget.add_child(label);
+    }
+    for (const auto& label : memory_labels) {
+        root_widget.add_child(label);
+    }
+    for (const auto& label : lua_labels) {
+        root_widget.add_child(label);
+    }
     root_widget.add_child(health_label);
     root_widget.add_child(powermeter_border_panel);
 
@@ -493,10 +827,15 @@ int main(int argc, char* argv[]) try {
         return tower_panels[selected_tower].json;
     };
 
+    auto get_selected_prefab = [&]() {
+        return tower_panels[selected_tower].prefab;
+    };
+
     select_tower(0);
 
     lua["select_tower"] = select_tower;
     lua["get_selected_tower"] = get_selected_tower;
+    lua["get_selected_prefab"] = get_selected_prefab;
 
     auto set_powermeter = [&](float percent) {
         powermeter_panel->set_size({16, 80*percent});
@@ -537,6 +876,10 @@ int main(int argc, char* argv[]) try {
         for (auto& enemy : json) {
             enemies.push_back({enemy["name"], enemy["template"]});
         }
+
+        prefabs.add_all("enemies/", json);
+
+        preload_scripts(json, preload_scripts);
     }
 
     auto rng = std::mt19937(std::random_device{}());
@@ -565,6 +908,51 @@ int main(int argc, char* argv[]) try {
                 std::cout << "Goodbye!" << std::endl;
                 running = false;
                 return true;
+            case SDL_KEYDOWN:
+                switch (event.key.keysym.scancode) {
+                    case SDL_SCANCODE_F3:
+                        show_profiler = !show_profiler;
+                        update_profiler_overlay();
+                        return true;
+                    case SDL_SCANCODE_F5:
+                        if (frame_graph->is_visible()) {
+                            frame_graph->hide();
+                        } else {
+                            frame_graph->show();
+                        }
+                        return true;
+                    case SDL_SCANCODE_F6:
+                        show_memory = !show_memory;
+                        update_memory_overlay();
+                        return true;
+                    case SDL_SCANCODE_F7:
+                        show_lua = !show_lua;
+                        if (show_lua) {
+                            sampler.reset();
+                            sampler.set_enabled(true);
+                        } else if (!sampler_enabled) {
+                            sampler.set_enabled(false);
+                        }
+                        update_lua_overlay();
+                        return true;
+                    case SDL_SCANCODE_F8:
+                        if (sampler.write_collapsed(sampler_output)) {
+                            std::cout << "Wrote " << sampler_output << " (" << sampler.get_total() << " Lua samples)" << std::endl;
+                        } else {
+                            std::cerr << "ERROR: Failed to write " << sampler_output << std::endl;
+                        }
+                        return true;
+                    case SDL_SCANCODE_F4:
+                        if (profiler::write_chrome_trace("ld41_trace.json")) {
+                            std::cout << "Wrote ld41_trace.json" << std::endl;
+                        } else {
+                            std::cerr << "ERROR: Failed to write ld41_trace.json" << std::endl;
+                        }
+                        return true;
+                    default:
+                        break;
+                }
+                break;
         }
 
         return false;
@@ -599,23 +987,96 @@ int main(int argc, char* argv[]) try {
 
 
     auto get_entities_at = [&](float x, float y, float r) {
-        auto vec = std::vector<ember_database::ent_id>{};
-        vec.reserve(8);
+        auto vec = frame_vector<ember_database::ent_id>{};
         entities.visit([&](ember_database::ent_id eid, const component::position& pos) {
                 if (glm::distance(glm::vec2{pos.x,pos.y}, glm::vec2{x,y}) < r) {
                     vec.push_back(eid);
                 }
             });
-        return vec;
+        // Copied into a Lua table; the arena storage must not outlive the frame.
+        return sol::as_table(std::move(vec));
     };
 
     lua["get_entities_at"] = get_entities_at;
 
+    std::cout << "Scheduling systems..." << std::endl;
+
+    auto scheduler = systems::scheduler();
+    scheduler.set_lua_sampler(sampler);
+
+    scheduler.add("movement", [](ember_database& db, double delta, command_buffer&) {
+            systems::movement(db, delta);
+        })
+        .reads<component::velocity>()
+        .writes<component::position>();
+
+    scheduler.add("collision", [&](ember_database& db, double delta, command_buffer&) {
+            systems::collision(db, delta, scripts);
+        })
+        .uses_lua();
+
+    scheduler.add("scripting", [&](ember_database& db, double delta, command_buffer&) {
+            systems::scripting(db, delta, scripts, tasks);
+        })
+        .uses_lua();
+
+    scheduler.add("detection", [&](ember_database& db, double delta, command_buffer&) {
+            systems::detection(db, delta, scripts);
+        })
+        .uses_lua();
+
+    // Health changes land after the scripts have seen this frame's state.
+    scheduler.add("fire_damage", [](ember_database& db, double delta, command_buffer& commands) {
+            systems::fire_damage(db, delta, commands);
+        })
+        .writes<component::fire_damage, component::health>()
+        .after("detection");
+
     using clock = std::chrono::steady_clock;
     auto prev_time = clock::now();
 
-    auto framerate_buffer = std::vector<std::chrono::nanoseconds>();
-    framerate_buffer.reserve(10);
+    auto stats_frames = 0;
+    auto timing_label = ""s;
+    auto timing_dump_time = prev_time;
+
+    auto update_frame_timing = [&](clock::duration frame_time, clock::duration sim_time, clock::duration render_time) {
+        using std::chrono::nanoseconds;
+        frame_timer.add_frame(nanoseconds(frame_time).count(), nanoseconds(sim_time).count(), nanoseconds(render_time).count());
+
+        if (++stats_frames >= 10) {
+            stats_frames = 0;
+
+            const auto& frame = frame_timer.get_frame();
+            char text[64];
+            std::snprintf(text, sizeof(text), "%ldfps p99 %.1fms", std::lround(1e9 / std::max<std::int64_t>(frame.mean(), 1)), frame.percentile(99) / 1e6);
+            framerate_stamp->set_text(renderer, text);
+
+            if (frame_graph->is_visible()) {
+                frame_timer.get_graph(frame_graph->get_values());
+            }
+
+            update_profiler_overlay();
+
+            if (show_memory) {
+                update_memory_overlay();
+            }
+
+            if (show_lua) {
+                update_lua_overlay();
+            }
+        }
+
+        auto now = clock::now();
+        auto interval_done = timing_dump_interval > 0 && now - timing_dump_time > std::chrono::duration<double>(timing_dump_interval);
+        if (timing_label != current_level || interval_done) {
+            if (timing_dump_interval > 0 && frame_timer.get_frame().count() > 0) {
+                frame_timer.write_csv_row(timing_dump_file, timing_label);
+            }
+            frame_timer.reset();
+            timing_label = current_level;
+            timing_dump_time = now;
+        }
+    };
 
     auto make_menu_state = [&](const std::string& name, const auto& on_next) {
         auto fade = 0.0;
@@ -626,52 +1087,30 @@ int main(int argc, char* argv[]) try {
             auto now = clock::now();
             auto delta_time = now - prev_time;
             prev_time = now;
-            framerate_buffer.push_back(delta_time);
-
-            if (framerate_buffer.size() >= 10) {
-                auto avg_frame_dur = std::accumulate(begin(framerate_buffer), end(framerate_buffer), 0ns) / framerate_buffer.size();
-                auto framerate = 1.0 / std::chrono::duration<double>(avg_frame_dur).count();
-
-                framerate_stamp->set_text(renderer, std::to_string(std::lround(framerate)) + "fps");
-                framerate_buffer.clear();
-            }
 
             auto delta = std::chrono::duration<double>(delta_time).count();
 
+            actions.begin_frame();
+
             SDL_Event event[2]; // Array is needed to work around stack issue in SDL_PollEvent.
             while (SDL_PollEvent(&event[0]))
             {
-                if (handle_gui_input(event[0])) break;
-                if (handle_game_input(event[0])) break;
+                if (handle_gui_input(event[0])) continue;
+                if (handle_game_input(event[0])) continue;
+                actions.handle_event(event[0]);
             }
 
-            const Uint8 *keys = SDL_GetKeyboardState(NULL);
-
-            auto update_input = [&](const std::string& name, SDL_Scancode key) {
-                if (input_table[name].valid()) {
-                    auto prev = bool(input_table[name]);
-                    auto curr = bool(keys[key]);
-                    input_table[name] = curr;
-                    input_table[name+"_pressed"] = curr && !prev;
-                    input_table[name+"_released"] = !curr && prev;
-                } else {
-                    input_table[name] = bool(keys[key]);
-                    input_table[name+"_pressed"] = bool(keys[key]);
-                    input_table[name+"_released"] = false;
-                }
-            };
-
-            update_input("shoot", SDL_SCANCODE_SPACE);
-
             // Update
 
+            auto sim_start = clock::now();
+
             fade += delta * fade_dir;
 
             if (fade > 1.f) {
                 fade = 1.f;
             }
 
-            if (fade == 1.f && input_table["shoot_pressed"]) {
+            if (fade == 1.f && actions.was_pressed(input::action::shoot)) {
                 fade_dir = -1.f;
             }
 
@@ -684,6 +1123,8 @@ int main(int argc, char* argv[]) try {
 
             // Render
 
+            auto render_start = clock::now();
+
             sushi::set_framebuffer(framebuffer);
             glClearColor(0,0,0,1);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -698,9 +1139,12 @@ int main(int argc, char* argv[]) try {
             auto frustum = sushi::frustum(proj*view);
 
             main_menu_bg->set_texture("bg/"+name);
-            renderer.begin();
-            main_menu_root_widget.draw(renderer, {0,0});
-            renderer.end();
+            {
+                EMBER_PROFILE_ZONE("gui::draw");
+                renderer.begin();
+                main_menu_root_widget.draw(renderer, {0,0});
+                renderer.end();
+            }
 
             {
                 sushi::set_framebuffer(nullptr);
@@ -725,7 +1169,9 @@ int main(int argc, char* argv[]) try {
 
             SDL_GL_SwapWindow(g_window);
 
-            lua.collect_garbage();
+            update_frame_timing(delta_time, render_start - sim_start, clock::now() - render_start);
+
+            gc.step(0, true);
         };
     };
 
@@ -759,65 +1205,29 @@ int main(int argc, char* argv[]) try {
         auto now = clock::now();
         auto delta_time = now - prev_time;
         prev_time = now;
-        framerate_buffer.push_back(delta_time);
 
-        if (framerate_buffer.size() >= 10) {
-            auto avg_frame_dur = std::accumulate(begin(framerate_buffer), end(framerate_buffer), 0ns) / framerate_buffer.size();
-            auto framerate = 1.0 / std::chrono::duration<double>(avg_frame_dur).count();
+        auto delta = std::chrono::duration<double>(delta_time).count();
 
-            framerate_stamp->set_text(renderer, std::to_string(std::lround(framerate)) + "fps");
-            framerate_buffer.clear();
-        }
+        EMBER_PROFILE_ZONE("gameplay");
 
-        auto delta = std::chrono::duration<double>(delta_time).count();
+        actions.begin_frame();
 
         SDL_Event event[2]; // Array is needed to work around stack issue in SDL_PollEvent.
         while (SDL_PollEvent(&event[0]))
         {
-            if (handle_gui_input(event[0])) break;
-            if (handle_game_input(event[0])) break;
+            if (handle_gui_input(event[0])) continue;
+            if (handle_game_input(event[0])) continue;
+            actions.handle_event(event[0]);
         }
 
-        const Uint8 *keys = SDL_GetKeyboardState(NULL);
-
-        auto update_input = [&](const std::string& name, SDL_Scancode key) {
-            if (input_table[name].valid()) {
-                auto prev = bool(input_table[name]);
-                auto curr = bool(keys[key]);
-                input_table[name] = curr;
-                input_table[name+"_pressed"] = curr && !prev;
-                input_table[name+"_released"] = !curr && prev;
-            } else {
-                input_table[name] = bool(keys[key]);
-                input_table[name+"_pressed"] = bool(keys[key]);
-                input_table[name+"_released"] = false;
-            }
-        };
-
-        update_input("left", SDL_SCANCODE_LEFT);
-        update_input("right", SDL_SCANCODE_RIGHT);
-        update_input("up", SDL_SCANCODE_UP);
-        update_input("down", SDL_SCANCODE_DOWN);
-        update_input("shoot", SDL_SCANCODE_SPACE);
-
-        update_input("number_1", SDL_SCANCODE_1);
-        update_input("number_2", SDL_SCANCODE_2);
-        update_input("number_3", SDL_SCANCODE_3);
-        update_input("number_4", SDL_SCANCODE_4);
-        update_input("number_5", SDL_SCANCODE_5);
-        update_input("number_6", SDL_SCANCODE_6);
-        update_input("number_7", SDL_SCANCODE_7);
-        update_input("number_8", SDL_SCANCODE_8);
-        update_input("number_9", SDL_SCANCODE_9);
-        update_input("number_0", SDL_SCANCODE_0);
-
         // Update
 
-        systems::movement(entities, delta);
-        systems::collision(entities, delta, environment_cache);
-        systems::scripting(entities, delta, environment_cache);
-        systems::detection(entities, delta, environment_cache);
-        systems::fire_damage(entities, delta);
+        auto sim_start = clock::now();
+
+        {
+            EMBER_PROFILE_ZONE("simulation");
+            scheduler.run(entities, delta);
+        }
 
         bool won = true;
 
@@ -829,7 +1239,7 @@ int main(int argc, char* argv[]) try {
           won = false;
         });
 
-        if (keys[SDL_SCANCODE_T]) {
+        if (SDL_GetKeyboardState(nullptr)[SDL_SCANCODE_T]) {
             won = true;
         }
 
@@ -848,10 +1258,17 @@ int main(int argc, char* argv[]) try {
             load_next_stage();
         }
 
-        systems::death_timer(entities, delta, environment_cache);
+        // Not scheduled, so it keeps running after the stage check as it always has.
+        {
+            EMBER_PROFILE_ZONE("death_timer");
+            auto sample = lua_sampler::scope(&sampler, "death_timer");
+            systems::death_timer(entities, delta, scripts);
+        }
 
         // Render
 
+        auto render_start = clock::now();
+
         sushi::set_framebuffer(framebuffer);
         glClearColor(0,0,0,1);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -877,6 +1294,7 @@ int main(int argc, char* argv[]) try {
         // 6 -> down / right turn path
         const auto& jsonLevel = *tile_level_cache.get(current_level);
 
+        EMBER_PROFILE_ZONE("render::tiles");
         sushi::set_program(program);
         sushi::set_texture(0, *texture_cache.get("tileset"));
         for (auto& tile : jsonLevel["tileset"]) {
@@ -895,6 +1313,7 @@ int main(int argc, char* argv[]) try {
         systems::render(entities, delta, proj, view, sprite_mesh, texture_cache, animation_cache);
 
         {
+            EMBER_PROFILE_ZONE("render::present");
             sushi::set_framebuffer(nullptr);
             glClearColor(0,0,0,1);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -914,19 +1333,77 @@ int main(int argc, char* argv[]) try {
             sushi::set_texture(0, framebuffer.color_texs[0]);
             sushi::draw_mesh(framebuffer_mesh);
 
+            EMBER_PROFILE_ZONE("gui::draw");
             renderer.begin();
             root_widget.draw(renderer, {0,0});
             renderer.end();
         }
 
+        auto work_time = clock::now() - now;
+
         SDL_GL_SwapWindow(g_window);
 
-        lua.collect_garbage();
+        update_frame_timing(delta_time, render_start - sim_start, clock::now() - render_start);
+
+        gc.step(std::chrono::nanoseconds(work_time).count(), false);
+    };
+
+    const auto& recorder_config = config.value("flight_recorder", nlohmann::json::object());
+    auto recorder = flight_recorder(
+        recorder_config.value("frames", 300),
+        recorder_config.value("budget_ms", 50.0),
+        recorder_config.value("dump_prefix", "ld41_spike_"));
+
+    const auto& alloc_config = config.value("alloc_tracker", nlohmann::json::object());
+    alloc_tracker::set_attribution(alloc_config.value("attribution", false));
+    const auto alloc_warmup_frames = alloc_config.value("warmup_frames", 300);
+    const auto alloc_budget = alloc_config.value("budget", -1);
+    const auto alloc_fail_on_budget = alloc_config.value("fail_on_budget", false);
+
+    // Frames since the last stage or screen change; loading is allowed to allocate.
+    auto alloc_steady_frames = 0;
+    auto alloc_steady_level = current_level;
+    auto alloc_steady_loop = loop;
+    auto alloc_budget_logged = false;
+    auto alloc_budget_failures = 0;
+
+    auto check_alloc_budget = [&](std::uint64_t frame_allocations) {
+        if (current_level != alloc_steady_level || loop != alloc_steady_loop) {
+            alloc_steady_frames = 0;
+            alloc_steady_level = current_level;
+            alloc_steady_loop = loop;
+            alloc_budget_logged = false;
+        }
+
+        if (++alloc_steady_frames <= alloc_warmup_frames || alloc_budget < 0 || frame_allocations <= std::uint64_t(alloc_budget)) {
+            return;
+        }
+
+        ++alloc_budget_failures;
+
+        if (!alloc_budget_logged) {
+            alloc_budget_logged = true;
+            std::cerr << "ERROR: Steady-state frame made " << frame_allocations << " allocations (budget " << alloc_budget << ")";
+            for (const auto& allocs : alloc_tracker::get_frame_allocs()) {
+                std::cerr << "\n  " << (allocs.name ? allocs.name : "(no zone)") << ": " << allocs.count << " (" << allocs.bytes << " bytes)";
+            }
+            std::cerr << std::endl;
+        }
+    };
+
+    std::function<void()> end_frame_func = [&]{
+        budget.end_frame();
+        profiler::frame_mark();
+        frame_arena::end_frame();
+        auto frame_allocations = alloc_tracker::frame_mark();
+        recorder.record(lua.memory_used(), gc.get_last_ns());
+        check_alloc_budget(frame_allocations);
     };
 
     std::cout << "Success." << std::endl;
 
     loop = &main_menu_loop;
+    end_frame = &end_frame_func;
 
 #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop(main_loop, 0, 1);
@@ -938,6 +1415,26 @@ int main(int argc, char* argv[]) try {
     SDL_DestroyWindow(g_window);
     SDL_Quit();
 
+    for (const auto& e : budget.get_entries()) {
+        if (e.aborted > 0 || e.frame_overruns > 0) {
+            std::clog << "Warning: Script " << e.name << " was aborted " << e.aborted << " times, went over its frame budget "
+                      << e.frame_overruns << " times and deferred " << e.deferred << " updates" << std::endl;
+        }
+    }
+
+    if (sampler.get_total() > 0) {
+        if (sampler.write_collapsed(sampler_output)) {
+            std::clog << "Wrote " << sampler.get_total() << " Lua samples to " << sampler_output << std::endl;
+        } else {
+            std::cerr << "ERROR: Failed to write " << sampler_output << std::endl;
+        }
+    }
+
+    if (alloc_fail_on_budget && alloc_budget_failures > 0) {
+        std::cerr << "ERROR: " << alloc_budget_failures << " frames exceeded the allocation budget" << std::endl;
+        return EXIT_FAILURE;
+    }
+
     return EXIT_SUCCESS;
 } catch (const std::exception& e) {
     std::cout << "Fatal exception: " << e.what() << std::endl;
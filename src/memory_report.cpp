@@ -0,0 +1,92 @@
+#include "memory_report.hpp"
+
+#include <soloud_wav.h>
+
+#include <algorithm>
+#include <iomanip>
+
+void memory_report::add(std::string category, std::string name, std::size_t bytes) {
+    entries.push_back({std::move(category), std::move(name), bytes});
+}
+
+std::size_t memory_report::total() const {
+    auto bytes = std::size_t(0);
+    for (const auto& e : entries) {
+        bytes += e.bytes;
+    }
+    return bytes;
+}
+
+std::size_t memory_report::total(const std::string& category) const {
+    auto bytes = std::size_t(0);
+    for (const auto& e : entries) {
+        if (e.category == category) {
+            bytes += e.bytes;
+        }
+    }
+    return bytes;
+}
+
+std::vector<memory_report::entry> memory_report::get_totals() const {
+    auto totals = std::vector<entry>{};
+    for (const auto& e : entries) {
+        auto iter = std::find_if(begin(totals), end(totals), [&](const entry& t) { return t.category == e.category; });
+        if (iter == end(totals)) {
+            totals.push_back({e.category, e.category, 0});
+            iter = end(totals) - 1;
+        }
+        iter->bytes += e.bytes;
+    }
+    std::sort(begin(totals), end(totals), [](const entry& a, const entry& b) { return a.bytes > b.bytes; });
+    return totals;
+}
+
+const std::vector<memory_report::entry>& memory_report::get_entries() const {
+    return entries;
+}
+
+void memory_report::print(std::ostream& out) const {
+    out << "Memory: " << total() / 1024 << " KiB total" << std::endl;
+    for (const auto& t : get_totals()) {
+        out << "  " << t.category << ": " << t.bytes / 1024 << " KiB" << std::endl;
+        for (const auto& e : entries) {
+            if (e.category == t.category && e.bytes > 0) {
+                out << "    " << std::left << std::setw(32) << e.name << " " << e.bytes << std::endl;
+            }
+        }
+    }
+}
+
+std::size_t memory_usage(const sushi::texture_2d& texture) {
+    return sizeof(texture) + std::size_t(texture.width) * texture.height * 4;
+}
+
+std::size_t memory_usage(const nlohmann::json& json) {
+    auto bytes = sizeof(json);
+    switch (json.type()) {
+        case nlohmann::json::value_t::object:
+            for (auto it = json.begin(); it != json.end(); ++it) {
+                bytes += it.key().capacity() + memory_usage(it.value()) + 3 * sizeof(void*);
+            }
+            break;
+        case nlohmann::json::value_t::array:
+            for (const auto& value : json) {
+                bytes += memory_usage(value);
+            }
+            break;
+        case nlohmann::json::value_t::string:
+            bytes += json.get_ref<const std::string&>().capacity();
+            break;
+        default:
+            break;
+    }
+    return bytes;
+}
+
+std::size_t memory_usage(const msdf_font& font) {
+    return sizeof(font) + font.memory_usage();
+}
+
+std::size_t memory_usage(const SoLoud::Wav& wav) {
+    return sizeof(wav) + std::size_t(wav.mSampleCount) * wav.mChannels * sizeof(float);
+}
@@ -0,0 +1,77 @@
+#ifndef LD41_MEMORY_REPORT_HPP
+#define LD41_MEMORY_REPORT_HPP
+
+#include "entities.hpp"
+#include "font.hpp"
+#include "json.hpp"
+#include "resource_cache.hpp"
+#include "utility.hpp"
+
+#include <Meta.h>
+#include <sushi/texture.hpp>
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace SoLoud {
+class Wav;
+} //namespace SoLoud
+
+std::size_t memory_usage(const sushi::texture_2d& texture);
+std::size_t memory_usage(const nlohmann::json& json);
+std::size_t memory_usage(const msdf_font& font);
+std::size_t memory_usage(const SoLoud::Wav& wav);
+
+template <typename T>
+std::size_t memory_usage(const T&) {
+    return 0;
+}
+
+/*! Breakdown of memory use by category and item.
+ *
+ * Sizes are estimates: container capacity for component storage, decoded
+ * pixel and sample data for textures and sounds, and an approximate DOM size
+ * for JSON. Items without a native footprint (e.g. Lua environments, which
+ * live in the Lua heap) report zero.
+ */
+class memory_report {
+public:
+    struct entry {
+        std::string category;
+        std::string name;
+        std::size_t bytes;
+    };
+
+    void add(std::string category, std::string name, std::size_t bytes);
+
+    template <typename T>
+    void add_cache(const std::string& category, const resource_cache<T, std::string>& cache) {
+        cache.for_each([&](const T& value, const std::string& name) {
+                add(category, name, memory_usage(value));
+            });
+    }
+
+    template <typename... Coms>
+    void add_components(ember_database& db, utility::type_list<Coms...>) {
+        add("entities", "entity table", db.entity_memory_usage());
+        (add("components", meta::getName<Coms>(), db.component_memory_usage<Coms>()), ...);
+    }
+
+    std::size_t total() const;
+    std::size_t total(const std::string& category) const;
+
+    /*! Category totals, largest first.
+     */
+    std::vector<entry> get_totals() const;
+
+    const std::vector<entry>& get_entries() const;
+
+    void print(std::ostream& out) const;
+
+private:
+    std::vector<entry> entries;
+};
+
+#endif //LD41_MEMORY_REPORT_HPP
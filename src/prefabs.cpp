@@ -0,0 +1,133 @@
+#include "prefabs.hpp"
+
+#include "components.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+using component_factory = std::function<void(ember_database&, ember_database::ent_id)>;
+
+struct component_reader {
+    component_factory (*compile)(const std::string& prefab, const nlohmann::json& json);
+    bool (*create)(ember_database& db, ember_database::ent_id eid, const nlohmann::json& json);
+};
+
+// Sets the fields of `com` present in `json`. Returns the first field that
+// can't be set from JSON, or null if there was none.
+template <typename T>
+const char* read_component(const nlohmann::json& json, T& com) {
+    const char* unsupported = nullptr;
+    meta::doForAllMembers<T>([&](auto& member) {
+            using member_type = meta::get_member_type<decltype(member)>;
+            auto iter = json.find(member.getName());
+            if (iter == json.end() || iter->is_null()) {
+                return;
+            }
+            if constexpr (std::is_arithmetic<member_type>::value || std::is_same<member_type, std::string>::value) {
+                member.set(com, iter->template get<member_type>());
+            } else if (!unsupported) {
+                unsupported = member.getName();
+            }
+        });
+    return unsupported;
+}
+
+template <typename T>
+component_factory compile_component(const std::string& prefab, const nlohmann::json& json) {
+    auto com = T{};
+    if (auto field = read_component(json, com)) {
+        std::cerr << "ERROR: Prefab " << prefab << ": Field " << meta::getName<T>() << "." << field << " can't be set from JSON" << std::endl;
+    }
+    return [com](ember_database& db, ember_database::ent_id eid) {
+        db.create_component(eid, com);
+    };
+}
+
+template <typename T>
+bool create_component(ember_database& db, ember_database::ent_id eid, const nlohmann::json& json) {
+    auto com = T{};
+    if (read_component(json, com)) {
+        return false;
+    }
+    db.create_component(eid, std::move(com));
+    return true;
+}
+
+template <typename... Coms>
+std::unordered_map<std::string, component_reader> make_readers(utility::type_list<Coms...>) {
+    return {{meta::getName<Coms>(), {&compile_component<Coms>, &create_component<Coms>}}...};
+}
+
+const std::unordered_map<std::string, component_reader>& get_readers() {
+    static const auto readers = make_readers(component::all{});
+    return readers;
+}
+
+} //static
+
+void prefab_registry::add(const std::string& name, const nlohmann::json& json) {
+    auto result = prefab{};
+    const auto& readers = get_readers();
+    for (auto iter = json.begin(); iter != json.end(); ++iter) {
+        auto reader = readers.find(iter.key());
+        if (reader == readers.end()) {
+            std::cerr << "ERROR: Prefab " << name << ": Unknown component " << iter.key() << std::endl;
+            continue;
+        }
+        try {
+            result.components.push_back(reader->second.compile(name, iter.value()));
+        } catch (const std::exception& e) {
+            std::cerr << "ERROR: Prefab " << name << ": Component " << iter.key() << ": " << e.what() << std::endl;
+        }
+    }
+    prefabs[name] = std::move(result);
+}
+
+void prefab_registry::add_all(const std::string& prefix, const nlohmann::json& list) {
+    for (const auto& entry : list) {
+        add(prefix + entry["name"].get<std::string>(), entry["template"]);
+    }
+}
+
+bool prefab_registry::contains(const std::string& name) const {
+    return prefabs.count(name) != 0;
+}
+
+prefab_registry::ent_id prefab_registry::spawn(ember_database& db, const std::string& name) const {
+    auto iter = prefabs.find(name);
+    if (iter == prefabs.end()) {
+        throw std::runtime_error("Unknown prefab: " + name);
+    }
+    auto eid = db.create_entity();
+    for (const auto& create : iter->second.components) {
+        create(db, eid);
+    }
+    return eid;
+}
+
+std::size_t prefab_registry::size() const {
+    return prefabs.size();
+}
+
+nlohmann::json create_components(ember_database& db, ember_database::ent_id eid, const nlohmann::json& json) {
+    auto rest = nlohmann::json{};
+    const auto& readers = get_readers();
+    for (auto iter = json.begin(); iter != json.end(); ++iter) {
+        auto reader = readers.find(iter.key());
+        auto created = false;
+        if (reader != readers.end()) {
+            try {
+                created = reader->second.create(db, eid, iter.value());
+            } catch (const std::exception&) {
+                // Left to the Lua loader, which reports it the same way as before.
+            }
+        }
+        if (!created) {
+            rest[iter.key()] = iter.value();
+        }
+    }
+    return rest;
+}
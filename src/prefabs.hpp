@@ -0,0 +1,62 @@
+#ifndef LD41_PREFABS_HPP
+#define LD41_PREFABS_HPP
+
+#include "entities.hpp"
+#include "json.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*! Entity templates compiled to component values.
+ *
+ * A template is the same JSON that `entity_from_json` takes: component names
+ * mapped to their fields. Adding one converts every component once, up front;
+ * spawning then copies the finished components into a new entity without
+ * touching JSON or Lua. Fields missing from the JSON keep their defaults, as
+ * with the Lua loader. Only number, bool and string fields can be set.
+ */
+class prefab_registry {
+public:
+    using ent_id = ember_database::ent_id;
+
+    /*! Compiles `json` as prefab `name`, replacing any prefab of that name.
+     *
+     * Unknown components and unsettable fields are reported and skipped.
+     */
+    void add(const std::string& name, const nlohmann::json& json);
+
+    /*! Adds each `{name, template}` in `list` as `prefix + name`, the layout of
+     * data/towers.json and data/enemies.json.
+     */
+    void add_all(const std::string& prefix, const nlohmann::json& list);
+
+    bool contains(const std::string& name) const;
+
+    /*! Creates an entity from prefab `name`. Throws std::runtime_error if there is no such prefab.
+     */
+    ent_id spawn(ember_database& db, const std::string& name) const;
+
+    std::size_t size() const;
+
+private:
+    using component_factory = std::function<void(ember_database&, ent_id)>;
+
+    struct prefab {
+        std::vector<component_factory> components;
+    };
+
+    std::unordered_map<std::string, prefab> prefabs;
+};
+
+/*! Creates the components in entity JSON `json` on `eid`, as the Lua loader would.
+ *
+ * Returns the components it left alone, for the Lua loader's load_components:
+ * unknown names, fields that can't be set from JSON, and values of the wrong
+ * type. Returns null if every component was created.
+ */
+nlohmann::json create_components(ember_database& db, ember_database::ent_id eid, const nlohmann::json& json);
+
+#endif //LD41_PREFABS_HPP
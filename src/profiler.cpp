@@ -0,0 +1,177 @@
+#include "profiler.hpp"
+
+#include "alloc_tracker.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace profiler {
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+constexpr std::size_t ring_size = 1 << 15;
+
+// Deeper zones are still counted, but charged to their parents' self time.
+constexpr std::uint32_t max_depth = 64;
+
+struct thread_buffer {
+    std::uint32_t tid = 0;
+    std::uint32_t depth = 0;
+    std::atomic<std::size_t> head = {0};
+    std::size_t frame_cursor = 0;
+    std::unique_ptr<event[]> events = std::make_unique<event[]>(ring_size);
+};
+
+struct registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<thread_buffer>> buffers;
+    std::vector<zone_stat> frame_stats;
+};
+
+registry& get_registry() {
+    static registry reg;
+    return reg;
+}
+
+const clock::time_point origin = clock::now();
+
+// Buffers are never freed, so a thread that exits leaves its zones behind for export.
+thread_buffer& get_thread_buffer() {
+    thread_local thread_buffer* buffer = [] {
+        auto& reg = get_registry();
+        std::lock_guard<std::mutex> lock (reg.mutex);
+        reg.buffers.push_back(std::make_unique<thread_buffer>());
+        reg.buffers.back()->tid = reg.buffers.size();
+        return reg.buffers.back().get();
+    }();
+    return *buffer;
+}
+
+template <typename F>
+std::size_t for_each_event(thread_buffer& buffer, std::size_t from, F&& func) {
+    auto head = buffer.head.load(std::memory_order_acquire);
+    auto first = std::max(from, head > ring_size ? head - ring_size : 0);
+    for (auto i = first; i < head; ++i) {
+        func(buffer.events[i % ring_size]);
+    }
+    return head;
+}
+
+void write_escaped(std::ostream& out, const char* str) {
+    for (; *str; ++str) {
+        if (*str == '"' || *str == '\\') {
+            out << '\\';
+        }
+        out << *str;
+    }
+}
+
+} //static
+
+zone::zone(const char* name) : name(name), parent(alloc_tracker::enter_zone(name)), start_ns(now_ns()) {
+    ++get_thread_buffer().depth;
+}
+
+zone::~zone() {
+    alloc_tracker::enter_zone(parent);
+    auto& buffer = get_thread_buffer();
+    --buffer.depth;
+    auto head = buffer.head.load(std::memory_order_relaxed);
+    buffer.events[head % ring_size] = event{name, start_ns, now_ns(), buffer.depth, false};
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void mark(const char* name) {
+    auto& buffer = get_thread_buffer();
+    auto head = buffer.head.load(std::memory_order_relaxed);
+    auto t = now_ns();
+    buffer.events[head % ring_size] = event{name, t, t, buffer.depth, true};
+    buffer.head.store(head + 1, std::memory_order_release);
+}
+
+std::int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - origin).count();
+}
+
+void frame_mark() {
+    auto& reg = get_registry();
+    std::lock_guard<std::mutex> lock (reg.mutex);
+
+    reg.frame_stats.clear();
+
+    for (auto& buffer : reg.buffers) {
+        // Zones are recorded as they end, so a zone's children all come before
+        // it; child_ns[d] sums the zones at depth d since their parent began.
+        std::int64_t child_ns[max_depth + 1] = {};
+        buffer->frame_cursor = for_each_event(*buffer, buffer->frame_cursor, [&](const event& e) {
+                auto iter = std::find_if(begin(reg.frame_stats), end(reg.frame_stats), [&](const zone_stat& s) {
+                        return s.name == e.name || std::strcmp(s.name, e.name) == 0;
+                    });
+                if (iter == end(reg.frame_stats)) {
+                    reg.frame_stats.push_back({e.name, 0, 0, 0, e.instant});
+                    iter = end(reg.frame_stats) - 1;
+                }
+                auto ns = e.end_ns - e.start_ns;
+                iter->total_ns += ns;
+                ++iter->count;
+                if (!e.instant && e.depth < max_depth) {
+                    iter->self_ns += ns - child_ns[e.depth + 1];
+                    child_ns[e.depth + 1] = 0;
+                    child_ns[e.depth] += ns;
+                }
+            });
+    }
+
+    std::sort(begin(reg.frame_stats), end(reg.frame_stats), [](const zone_stat& a, const zone_stat& b) {
+            return a.total_ns > b.total_ns;
+        });
+}
+
+const std::vector<zone_stat>& get_frame_stats() {
+    return get_registry().frame_stats;
+}
+
+bool write_chrome_trace(const std::string& filename) {
+    std::ofstream file (filename);
+
+    if (!file) {
+        return false;
+    }
+
+    auto& reg = get_registry();
+    std::lock_guard<std::mutex> lock (reg.mutex);
+
+    file << "{\"traceEvents\":[";
+
+    auto first = true;
+    for (auto& buffer : reg.buffers) {
+        for_each_event(*buffer, 0, [&](const event& e) {
+                if (!first) {
+                    file << ",\n";
+                }
+                first = false;
+                file << "{\"name\":\"";
+                write_escaped(file, e.name);
+                file << "\",\"pid\":1,\"tid\":" << buffer->tid
+                     << ",\"ts\":" << e.start_ns / 1000.0;
+                if (e.instant) {
+                    file << ",\"ph\":\"i\",\"s\":\"t\"}";
+                } else {
+                    file << ",\"ph\":\"X\",\"dur\":" << (e.end_ns - e.start_ns) / 1000.0 << "}";
+                }
+            });
+    }
+
+    file << "]}\n";
+
+    return bool(file);
+}
+
+} //namespace profiler
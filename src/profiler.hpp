@@ -0,0 +1,88 @@
+#ifndef LD41_PROFILER_HPP
+#define LD41_PROFILER_HPP
+
+#include "utility.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef LD41_PROFILER
+#define EMBER_PROFILE_ZONE(NAME) ::profiler::zone EMBER_CAT(_profile_zone_, __LINE__) {NAME}
+#define EMBER_PROFILE_MARK(NAME) ::profiler::mark(NAME)
+#else
+#define EMBER_PROFILE_ZONE(NAME) (void)0
+#define EMBER_PROFILE_MARK(NAME) (void)0
+#endif
+
+/*! Scoped timing zones.
+ *
+ * Each thread records into its own fixed-size ring buffer, so recording never
+ * allocates or locks after a thread's first zone. Zone names must outlive the
+ * profiler; string literals are expected.
+ *
+ * The innermost zone on each thread is also the one charged for allocations
+ * by alloc_tracker.
+ *
+ * Readers (`get_frame_stats`, `write_chrome_trace`) must be called between
+ * frames, when no other thread is recording.
+ */
+namespace profiler {
+
+struct event {
+    const char* name;
+    std::int64_t start_ns;
+    std::int64_t end_ns;
+    std::uint32_t depth;
+    bool instant;
+};
+
+struct zone_stat {
+    const char* name;
+    std::int64_t total_ns;
+    std::int64_t self_ns; //!< total_ns less the time in zones nested inside it
+    int count;
+    bool instant;
+};
+
+class zone {
+public:
+    zone(const char* name);
+    ~zone();
+
+    zone(const zone&) = delete;
+    zone& operator=(const zone&) = delete;
+
+private:
+    const char* name;
+    const char* parent;
+    std::int64_t start_ns;
+};
+
+std::int64_t now_ns();
+
+/*! Records a zero-length event, e.g. a cache miss.
+ *
+ * Marks show up in the frame stats with a count but no time.
+ */
+void mark(const char* name);
+
+/*! Marks the end of a frame.
+ *
+ * Aggregates the zones recorded since the previous mark into the frame stats.
+ */
+void frame_mark();
+
+/*! Per-zone totals of the last complete frame, slowest first.
+ */
+const std::vector<zone_stat>& get_frame_stats();
+
+/*! Writes every buffered zone as Chrome trace-event JSON.
+ *
+ * Load the file in chrome://tracing or Perfetto.
+ */
+bool write_chrome_trace(const std::string& filename);
+
+} //namespace profiler
+
+#endif //LD41_PROFILER_HPP
@@ -1,12 +1,15 @@
 #ifndef LD41_RESOURCE_CACHE_HPP
 #define LD41_RESOURCE_CACHE_HPP
 
+#include "profiler.hpp"
+
 #include <functional>
 #include <memory>
 #include <unordered_map>
 #include <utility>
 #include <type_traits>
 #include <map>
+#include <tuple>
 
 template <typename T, typename... S>
 class resource_cache {
@@ -24,6 +27,8 @@ public:
     std::shared_ptr<T> get(const S&... s) {
         auto& ptr = cache[std::tie(s...)];
         if (!ptr) {
+            EMBER_PROFILE_MARK("resource_cache::miss");
+            EMBER_PROFILE_ZONE("resource_cache::load");
             ptr = factory(s...);
         }
         return ptr;
@@ -33,8 +38,18 @@ public:
         cache.clear();
     }
 
+    template <typename F>
+    void for_each(F&& func) const {
+        for (const auto& entry : cache) {
+            if (entry.second) {
+                std::apply([&](const S&... s) { func(*entry.second, s...); }, entry.first);
+            }
+        }
+    }
+
     std::shared_ptr<T> reload(const S&... s) {
         auto& ptr = cache[std::tie(s...)];
+        EMBER_PROFILE_ZONE("resource_cache::load");
         ptr = factory(s...);
         return ptr;
     }
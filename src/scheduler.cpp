@@ -0,0 +1,151 @@
+#include "scheduler.hpp"
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace systems {
+
+namespace {
+
+bool intersects(const std::vector<std::type_index>& a, const std::vector<std::type_index>& b) {
+    for (auto& t : a) {
+        if (std::find(begin(b), end(b), t) != end(b)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} //static
+
+bool system_desc::conflicts_with(const system_desc& other) const {
+    if (lua || other.lua) {
+        return true;
+    }
+    return intersects(write_set, other.write_set) ||
+        intersects(write_set, other.read_set) ||
+        intersects(read_set, other.write_set);
+}
+
+scheduler::scheduler(std::size_t num_workers) : pool(num_workers) {}
+
+system_desc& scheduler::add(std::string name, system_function func) {
+    dirty = true;
+    systems.emplace_back();
+    buffers.emplace_back();
+    auto& desc = systems.back();
+    desc.name = std::move(name);
+    desc.run = std::move(func);
+    return desc;
+}
+
+void scheduler::run(ember_database& entities, double delta) {
+    if (dirty) {
+        build();
+    }
+
+    for (auto& batch : batches) {
+        auto main_thread_job = batch.back();
+
+        for (auto i : batch) {
+            auto& sys = systems[i];
+            if (sys.lua) {
+                main_thread_job = i;
+            }
+        }
+
+        for (auto i : batch) {
+            if (i != main_thread_job) {
+                pool.submit([&, i]{
+                        EMBER_PROFILE_ZONE(systems[i].name.c_str());
+                        systems[i].run(entities, delta, buffers[i]);
+                    });
+            }
+        }
+
+        {
+            EMBER_PROFILE_ZONE(systems[main_thread_job].name.c_str());
+            auto& sys = systems[main_thread_job];
+            auto sample = lua_sampler::scope(sys.lua ? sampler : nullptr, sys.name.c_str());
+            sys.run(entities, delta, buffers[main_thread_job]);
+        }
+
+        pool.wait();
+
+        EMBER_PROFILE_ZONE("scheduler::flush");
+        for (auto i : batch) {
+            buffers[i].flush(entities);
+        }
+    }
+}
+
+void scheduler::set_lua_sampler(lua_sampler& sampler) {
+    this->sampler = &sampler;
+}
+
+const std::vector<std::vector<std::size_t>>& scheduler::get_batches() {
+    if (dirty) {
+        build();
+    }
+    return batches;
+}
+
+const system_desc& scheduler::get_system(std::size_t i) const {
+    return systems[i];
+}
+
+void scheduler::build() {
+    auto n = systems.size();
+    auto deps = std::vector<std::vector<std::size_t>>(n);
+
+    for (std::size_t j = 0; j < n; ++j) {
+        for (std::size_t i = 0; i < j; ++i) {
+            if (systems[j].conflicts_with(systems[i])) {
+                deps[j].push_back(i);
+            }
+        }
+        for (auto& name : systems[j].run_after) {
+            auto iter = std::find_if(begin(systems), end(systems), [&](auto& s){ return s.name == name; });
+            if (iter == end(systems)) {
+                throw std::runtime_error("System "+systems[j].name+" depends on unknown system "+name+".");
+            }
+            deps[j].push_back(iter - begin(systems));
+        }
+    }
+
+    // Longest-path layering; a system's batch is one past its latest dependency.
+    auto level = std::vector<int>(n, -1);
+    auto visiting = std::vector<bool>(n, false);
+
+    std::function<int(std::size_t)> get_level = [&](std::size_t i) {
+        if (level[i] >= 0) {
+            return level[i];
+        }
+        if (visiting[i]) {
+            throw std::runtime_error("System dependency cycle at "+systems[i].name+".");
+        }
+        visiting[i] = true;
+        auto l = 0;
+        for (auto d : deps[i]) {
+            l = std::max(l, get_level(d) + 1);
+        }
+        visiting[i] = false;
+        level[i] = l;
+        return l;
+    };
+
+    batches.clear();
+    for (std::size_t i = 0; i < n; ++i) {
+        auto l = std::size_t(get_level(i));
+        if (batches.size() <= l) {
+            batches.resize(l + 1);
+        }
+        batches[l].push_back(i);
+    }
+
+    dirty = false;
+}
+
+} //namespace systems
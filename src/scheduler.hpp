@@ -0,0 +1,97 @@
+#ifndef LD41_SCHEDULER_HPP
+#define LD41_SCHEDULER_HPP
+
+#include "command_buffer.hpp"
+#include "entities.hpp"
+#include "lua_sampler.hpp"
+#include "thread_pool.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <typeindex>
+#include <vector>
+
+namespace systems {
+
+using system_function = std::function<void(ember_database& entities, double delta, command_buffer& commands)>;
+
+/*! Description of a system and the data it touches.
+ *
+ * Systems that only read and write the declared components may run alongside
+ * any other system they do not conflict with. Structural changes (creating or
+ * destroying entities and components) must go through the command buffer.
+ *
+ * Systems that call into Lua are pinned to the main thread and treated as
+ * touching everything, since a script can do anything to the database.
+ */
+struct system_desc {
+    std::string name;
+    system_function run;
+    std::vector<std::type_index> read_set;
+    std::vector<std::type_index> write_set;
+    std::vector<std::string> run_after;
+    bool lua = false;
+
+    template <typename... Coms>
+    system_desc& reads() {
+        (read_set.emplace_back(typeid(Coms)), ...);
+        return *this;
+    }
+
+    template <typename... Coms>
+    system_desc& writes() {
+        (write_set.emplace_back(typeid(Coms)), ...);
+        return *this;
+    }
+
+    system_desc& after(std::string other) {
+        run_after.push_back(std::move(other));
+        return *this;
+    }
+
+    system_desc& uses_lua() {
+        lua = true;
+        return *this;
+    }
+
+    bool conflicts_with(const system_desc& other) const;
+};
+
+/*! Runs registered systems in dependency order.
+ *
+ * Systems registered earlier run before later systems they conflict with.
+ * Non-conflicting systems are grouped into batches that run concurrently on
+ * the thread pool, with the main thread taking a share of the work.
+ * Command buffers are flushed in registration order after each batch.
+ */
+class scheduler {
+public:
+    scheduler(std::size_t num_workers = thread_pool::default_size());
+
+    system_desc& add(std::string name, system_function func);
+
+    void run(ember_database& entities, double delta);
+
+    /*! Labels the Lua code run by systems that use Lua with the system name.
+     */
+    void set_lua_sampler(lua_sampler& sampler);
+
+    const std::vector<std::vector<std::size_t>>& get_batches();
+
+    const system_desc& get_system(std::size_t i) const;
+
+private:
+    void build();
+
+    std::vector<system_desc> systems;
+    std::vector<command_buffer> buffers;
+    std::vector<std::vector<std::size_t>> batches;
+    bool dirty = true;
+    thread_pool pool;
+    lua_sampler* sampler = nullptr;
+};
+
+} //namespace systems
+
+#endif //LD41_SCHEDULER_HPP
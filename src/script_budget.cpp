@@ -0,0 +1,157 @@
+#include "script_budget.hpp"
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+int get_depth(lua_State* L) {
+    auto ar = lua_Debug{};
+    auto level = 0;
+    while (lua_getstack(L, level, &ar)) {
+        ++level;
+    }
+    return level;
+}
+
+// True if the `depth` innermost frames of `L` are all Lua functions, so an
+// error raised now skips no native code on its way to the call's pcall.
+bool is_lua_only(lua_State* L, int depth) {
+    auto ar = lua_Debug{};
+    for (auto level = 0; level < depth && lua_getstack(L, level, &ar); ++level) {
+        lua_getinfo(L, "S", &ar);
+        if (ar.what[0] == 'C') {
+            return false;
+        }
+    }
+    return true;
+}
+
+} //static
+
+bool script_budget::entry::is_exhausted() const {
+    return budget.defer && budget.frame_ms >= 0 && frame_ns >= budget.frame_ms * 1e6;
+}
+
+script_budget::call_scope::call_scope(script_budget* budget, entry* e, lua_State* L) :
+    budget(e ? budget : nullptr)
+{
+    if (this->budget) {
+        this->budget->begin_call(e, L);
+    }
+}
+
+script_budget::call_scope::~call_scope() {
+    if (budget) {
+        budget->end_call();
+    }
+}
+
+script_budget::script_budget(lua_hook& hook, limits defaults) :
+    hook(hook),
+    defaults(defaults)
+{
+    hook.add(&on_hook, this);
+}
+
+script_budget::~script_budget() {
+    hook.remove(&on_hook, this);
+}
+
+void script_budget::set_limits(const std::string& name, limits budget) {
+    overrides[name] = budget;
+    auto iter = by_name.find(name);
+    if (iter != end(by_name)) {
+        iter->second->budget = budget;
+    }
+}
+
+script_budget::entry& script_budget::get_entry(const std::string& name) {
+    auto iter = by_name.find(name);
+    if (iter != end(by_name)) {
+        return *iter->second;
+    }
+
+    auto e = entry{};
+    e.name = name;
+    auto override_iter = overrides.find(name);
+    e.budget = override_iter != end(overrides) ? override_iter->second : defaults;
+
+    entries.push_back(std::move(e));
+    by_name.emplace(name, &entries.back());
+
+    return entries.back();
+}
+
+void script_budget::end_frame() {
+    for (auto& e : entries) {
+        if (e.budget.frame_ms >= 0 && e.frame_ns > e.budget.frame_ms * 1e6) {
+            EMBER_PROFILE_MARK("script_budget::overrun");
+            if (e.frame_overruns++ == 0) {
+                std::clog << "Warning: Script " << e.name << " took " << e.frame_ns / 1e6 << "ms in one frame, over its "
+                          << e.budget.frame_ms << "ms budget" << std::endl;
+            }
+        }
+        e.frame_ns = 0;
+    }
+}
+
+const std::deque<script_budget::entry>& script_budget::get_entries() const {
+    return entries;
+}
+
+// Raises a Lua error through the hook, so nothing here may need destruction.
+void script_budget::on_hook(void* ud, lua_State* L) {
+    auto self = static_cast<script_budget*>(ud);
+
+    if (self->calls.empty()) {
+        return;
+    }
+
+    auto& call = self->calls.back();
+    auto& limit = call.e->budget;
+
+    call.instructions += self->hook.get_interval();
+
+    if (!call.overrun) {
+        auto over_instructions = limit.call_instructions >= 0 && call.instructions > limit.call_instructions;
+        auto over_time = call.deadline_ns >= 0 && profiler::now_ns() > call.deadline_ns;
+        call.overrun = over_instructions || over_time;
+    }
+
+    if (!call.overrun) {
+        return;
+    }
+
+    // Other threads, such as coroutines resumed by the script, catch errors in lua_resume.
+    auto base_depth = L == call.L ? call.base_depth : 0;
+    if (!is_lua_only(L, get_depth(L) - base_depth)) {
+        return;
+    }
+
+    ++call.e->aborted;
+    luaL_error(L, "script budget exceeded (%d instructions, %f ms)",
+        int(call.instructions), (profiler::now_ns() - call.start_ns) / 1e6);
+}
+
+void script_budget::begin_call(entry* e, lua_State* L) {
+    auto now = profiler::now_ns();
+    auto deadline = e->budget.call_ms >= 0 ? now + std::int64_t(e->budget.call_ms * 1e6) : -1;
+    calls.push_back({e, now, deadline, 0, L, L ? get_depth(L) : 0, false});
+}
+
+void script_budget::end_call() {
+    auto call = calls.back();
+    calls.pop_back();
+
+    auto ns = profiler::now_ns() - call.start_ns;
+
+    auto& e = *call.e;
+    ++e.calls;
+    e.instructions += call.instructions;
+    e.total_ns += ns;
+    e.max_ns = std::max(e.max_ns, ns);
+    e.frame_ns += ns;
+}
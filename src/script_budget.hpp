@@ -0,0 +1,117 @@
+#ifndef LD41_SCRIPT_BUDGET_HPP
+#define LD41_SCRIPT_BUDGET_HPP
+
+#include "lua_hook.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*! CPU accounting and limits for entity scripts.
+ *
+ * Every callback run through script_registry::call is timed and, through the
+ * shared count hook, has its instructions counted (to the hook interval). A
+ * single call that runs past `call_instructions` or `call_ms` is aborted with a
+ * Lua error, so a runaway loop costs at most that much of a frame.
+ *
+ * The error unwinds every frame up to the call, so it is only raised while all
+ * of those frames are Lua. A call that goes over inside a native function
+ * (which may re-enter Lua with C++ objects alive) or a Lua `pcall` is flagged
+ * and aborted at the next hook back in plain Lua code.
+ *
+ * Each script also has a per-frame budget, `frame_ms`. Going over it is counted
+ * as a frame overrun. For scripts with `defer` set, the scripting system stops
+ * running their per-entity updates for the frame once the budget is spent, and
+ * starts from the first skipped entity next frame. `update_all` is a single
+ * call for every entity, so it is never deferred; only its call limits apply.
+ *
+ * Negative limits are unlimited.
+ */
+class script_budget {
+public:
+    struct limits {
+        std::int64_t call_instructions = -1;
+        double call_ms = -1;
+        double frame_ms = -1;
+        bool defer = false;
+    };
+
+    struct entry {
+        std::string name;
+        limits budget;
+        std::uint64_t calls = 0;
+        std::uint64_t instructions = 0;
+        std::int64_t total_ns = 0;
+        std::int64_t max_ns = 0;
+        std::int64_t frame_ns = 0;
+        std::uint64_t aborted = 0;
+        std::uint64_t frame_overruns = 0;
+        std::uint64_t deferred = 0;
+
+        /*! True once a script with `defer` set has used up its frame budget.
+         */
+        bool is_exhausted() const;
+    };
+
+    /*! Times one call for its whole scope.
+     *
+     * `L` is the state the call runs on, whose frames at this point are outside
+     * the call. Pass null when resuming a coroutine, whose frames all belong to it.
+     */
+    class call_scope {
+    public:
+        call_scope(script_budget* budget, entry* e, lua_State* L);
+        ~call_scope();
+
+        call_scope(const call_scope&) = delete;
+        call_scope& operator=(const call_scope&) = delete;
+
+    private:
+        script_budget* budget;
+    };
+
+    script_budget(lua_hook& hook, limits defaults);
+    ~script_budget();
+
+    script_budget(const script_budget&) = delete;
+    script_budget& operator=(const script_budget&) = delete;
+
+    void set_limits(const std::string& name, limits budget);
+
+    /*! Returns the entry for a script, creating it with the default limits. Entries are never removed.
+     */
+    entry& get_entry(const std::string& name);
+
+    /*! Counts frame overruns and resets the per-frame totals.
+     */
+    void end_frame();
+
+    const std::deque<entry>& get_entries() const;
+
+private:
+    struct active_call {
+        entry* e;
+        std::int64_t start_ns;
+        std::int64_t deadline_ns;
+        std::int64_t instructions;
+        lua_State* L;
+        int base_depth;
+        bool overrun;
+    };
+
+    static void on_hook(void* ud, lua_State* L);
+
+    void begin_call(entry* e, lua_State* L);
+    void end_call();
+
+    lua_hook& hook;
+    limits defaults;
+    std::unordered_map<std::string, limits> overrides;
+    std::deque<entry> entries;
+    std::unordered_map<std::string, entry*> by_name;
+    std::vector<active_call> calls;
+};
+
+#endif //LD41_SCRIPT_BUDGET_HPP
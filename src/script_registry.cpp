@@ -0,0 +1,111 @@
+#include "script_registry.hpp"
+
+#include "profiler.hpp"
+
+namespace {
+
+sol::protected_function get_callback(const sol::environment& env, const char* name) {
+    sol::object obj = env[name];
+    if (obj.get_type() == sol::type::function) {
+        return obj.as<sol::protected_function>();
+    }
+    return {};
+}
+
+} //static
+
+script_registry::script_registry(resource_cache<sol::environment, std::string>& environment_cache) :
+    environment_cache(environment_cache)
+{}
+
+void script_registry::set_natives(behaviour_registry& natives) {
+    this->natives = &natives;
+}
+
+behaviour_context& script_registry::get_native_context() {
+    return natives->get_context();
+}
+
+void script_registry::set_workers(lua_workers& workers) {
+    this->workers = &workers;
+}
+
+lua_workers* script_registry::get_workers() {
+    return workers;
+}
+
+void script_registry::set_budget(script_budget& budget) {
+    this->budget = &budget;
+}
+
+script_budget* script_registry::get_budget() {
+    return budget;
+}
+
+void script_registry::set_sampler(lua_sampler& sampler) {
+    this->sampler = &sampler;
+}
+
+lua_sampler* script_registry::get_sampler() {
+    return sampler;
+}
+
+int script_registry::get_handle(const std::string& name) {
+    auto iter = handles.find(name);
+    if (iter != end(handles)) {
+        return iter->second;
+    }
+
+    auto handle = int(records.size());
+
+    if (auto native = natives ? natives->get(name) : nullptr) {
+        auto rec = record{};
+        rec.name = name;
+        rec.native = native;
+        records.push_back(std::move(rec));
+        handles.emplace(name, handle);
+        return handle;
+    }
+
+    EMBER_PROFILE_ZONE("script_registry::load");
+
+    auto env = *environment_cache.get(name);
+
+    auto rec = record{};
+    rec.name = name;
+    rec.update = get_callback(env, "update");
+    rec.on_collide = get_callback(env, "on_collide");
+    rec.on_enter = get_callback(env, "on_enter");
+    rec.on_leave = get_callback(env, "on_leave");
+    rec.on_death = get_callback(env, "on_death");
+    rec.update_all = get_callback(env, "update_all");
+    rec.run = get_callback(env, "run");
+    rec.parallel = workers && env["parallel"] == true;
+    if (budget) {
+        rec.budget = &budget->get_entry(name);
+    }
+    if (rec.update_all.valid()) {
+        rec.batch = sol::table(env.lua_state(), sol::create);
+    }
+    rec.environment = std::move(env);
+
+    records.push_back(std::move(rec));
+    handles.emplace(name, handle);
+
+    return handle;
+}
+
+script_registry::record& script_registry::get(int handle) {
+    return records[handle];
+}
+
+script_registry::record& script_registry::get(component::script& script) {
+    if (script.handle < 0) {
+        script.handle = get_handle(script.name);
+    }
+    return records[script.handle];
+}
+
+std::size_t script_registry::size() const {
+    return records.size();
+}
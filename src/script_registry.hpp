@@ -0,0 +1,133 @@
+#ifndef LD41_SCRIPT_REGISTRY_HPP
+#define LD41_SCRIPT_REGISTRY_HPP
+
+#include "behaviour_registry.hpp"
+#include "components.hpp"
+#include "lua_sampler.hpp"
+#include "lua_workers.hpp"
+#include "script_budget.hpp"
+#include "resource_cache.hpp"
+
+#include <sol.hpp>
+
+#include <deque>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*! Compiled entity scripts, addressed by small integer handles.
+ *
+ * Each script is loaded once into a record holding its environment and a
+ * handle to every callback the engine dispatches, so a call is an index and a
+ * pcall instead of a cache lookup and a table lookup. Missing callbacks are
+ * left invalid.
+ *
+ * Scripts with a native behaviour registered under their name are not loaded
+ * into Lua at all; their record only points at the behaviour. Scripts that set
+ * `parallel = true` have their updates run on the worker states, if any.
+ *
+ * Records are never removed, so references and handles stay valid.
+ */
+class script_registry {
+public:
+    struct record {
+        std::string name;
+        behaviour* native = nullptr;
+        bool parallel = false;
+        script_budget::entry* budget = nullptr;
+        std::size_t resume = 0; // where deferred per-entity updates pick up next frame
+        sol::environment environment;
+        sol::protected_function update;
+        sol::protected_function on_collide;
+        sol::protected_function on_enter;
+        sol::protected_function on_leave;
+        sol::protected_function on_death;
+
+        /*! Optional `run(eid)`, started once per entity as a coroutine by script_tasks.
+         */
+        sol::protected_function run;
+
+        /*! Optional `update_all(eids, delta, count)`, called once per frame for every entity running the script.
+         */
+        sol::protected_function update_all;
+
+        /*! Reused argument table for `update_all`, and the entities collected for it this frame.
+         */
+        sol::table batch;
+        std::size_t batch_size = 0;
+        std::vector<ember_database::ent_id> pending;
+    };
+
+    explicit script_registry(resource_cache<sol::environment, std::string>& environment_cache);
+
+    /*! Replaces scripts with the behaviours in `natives`, for scripts loaded from now on.
+     */
+    void set_natives(behaviour_registry& natives);
+
+    behaviour_context& get_native_context();
+
+    /*! Runs the updates of parallel scripts loaded from now on on `workers`.
+     */
+    void set_workers(lua_workers& workers);
+
+    /*! Returns the worker states, or null.
+     */
+    lua_workers* get_workers();
+
+    /*! Accounts and limits the calls of scripts loaded from now on with `budget`.
+     */
+    void set_budget(script_budget& budget);
+
+    /*! Returns the budget, or null.
+     */
+    script_budget* get_budget();
+
+    /*! Labels the calls of every script with `sampler`.
+     */
+    void set_sampler(lua_sampler& sampler);
+
+    /*! Returns the sampler, or null.
+     */
+    lua_sampler* get_sampler();
+
+    /*! Returns the handle for a script, loading it on first use.
+     */
+    int get_handle(const std::string& name);
+
+    record& get(int handle);
+
+    /*! Returns the record for a script component, resolving its handle on first use.
+     */
+    record& get(component::script& script);
+
+    std::size_t size() const;
+
+    /*! Calls a callback of `rec`, logging rather than throwing on script errors.
+     *
+     * Returns false if the callback failed.
+     */
+    template <typename... Args>
+    bool call(const record& rec, const sol::protected_function& func, const char* callback, Args&&... args) {
+        auto scope = script_budget::call_scope(budget, rec.budget, func.lua_state());
+        auto sample = lua_sampler::scope(sampler, rec.name.c_str(), callback);
+        auto result = func(std::forward<Args>(args)...);
+        if (!result.valid()) {
+            sol::error err = result;
+            std::cerr << "ERROR: " << rec.name << "." << callback << ": " << err.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    resource_cache<sol::environment, std::string>& environment_cache;
+    behaviour_registry* natives = nullptr;
+    lua_workers* workers = nullptr;
+    script_budget* budget = nullptr;
+    lua_sampler* sampler = nullptr;
+    std::deque<record> records;
+    std::unordered_map<std::string, int> handles;
+};
+
+#endif //LD41_SCRIPT_REGISTRY_HPP
@@ -0,0 +1,214 @@
+#include "script_tasks.hpp"
+
+#include "components.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// Min-heap on wake time; the sequence number keeps tasks due at the same time in order.
+template <typename T>
+bool later(const T& a, const T& b) {
+    return a.time > b.time || (a.time == b.time && a.seq > b.seq);
+}
+
+int check_coroutine(lua_State* L, const char* func) {
+    if (lua_pushthread(L)) {
+        return luaL_error(L, "%s() may only be called from run()", func);
+    }
+    lua_pop(L, 1);
+    return 0;
+}
+
+} //static
+
+script_tasks::script_tasks(sol::state_view lua, ember_database& entities, script_registry& scripts) :
+    L(lua.lua_state()),
+    entities(entities),
+    scripts(scripts)
+{
+    lua_pushcfunction(L, &lua_wait);
+    lua_setglobal(L, "wait");
+    lua_pushcfunction(L, &lua_wait_until);
+    lua_setglobal(L, "wait_until");
+    lua_pushlightuserdata(L, this);
+    lua_pushcclosure(L, &lua_signal, 1);
+    lua_setglobal(L, "signal");
+}
+
+script_tasks::~script_tasks() {
+    clear();
+    lua_pushnil(L);
+    lua_setglobal(L, "signal");
+}
+
+void script_tasks::start(const script_registry::record& rec, int handle, ent_id eid) {
+    EMBER_PROFILE_ZONE("lua::resume");
+
+    auto index = int(tasks.size());
+    if (free_tasks.empty()) {
+        tasks.emplace_back();
+    } else {
+        index = free_tasks.back();
+        free_tasks.pop_back();
+    }
+
+    auto& t = tasks[index];
+    t.thread = lua_newthread(L);
+    t.ref = luaL_ref(L, LUA_REGISTRYINDEX);
+    t.handle = handle;
+    t.eid = eid;
+    t.id = entities.has_component<component::net_id>(eid) ? entities.get_component<component::net_id>(eid).id : 0;
+
+    rec.run.push();
+    lua_xmove(L, t.thread, 1);
+    sol::stack::push(t.thread, eid);
+
+    resume(index, 1);
+}
+
+void script_tasks::update(double delta) {
+    now += delta;
+
+    ready.clear();
+
+    for (auto& event : signals) {
+        auto iter = waiting.find(event);
+        if (iter != end(waiting)) {
+            ready.insert(end(ready), begin(iter->second), end(iter->second));
+            waiting.erase(iter);
+        }
+    }
+    signals.clear();
+
+    // Everything due is taken off the heap before anything runs, so a task
+    // that waits again is resumed no earlier than the next update.
+    while (!heap.empty() && heap.front().time <= now) {
+        std::pop_heap(begin(heap), end(heap), later<wake>);
+        ready.push_back(heap.back().task);
+        heap.pop_back();
+    }
+
+    if (ready.empty()) {
+        return;
+    }
+
+    EMBER_PROFILE_ZONE("lua::resume");
+
+    // A task may clear() everything by loading a stage, which empties `ready`.
+    for (std::size_t i = 0; i < ready.size(); ++i) {
+        auto index = ready[i];
+        if (is_valid(tasks[index])) {
+            resume(index, 0);
+        } else {
+            release(index);
+        }
+    }
+}
+
+void script_tasks::signal(const std::string& event) {
+    signals.push_back(event);
+}
+
+void script_tasks::clear() {
+    for (auto& t : tasks) {
+        if (t.ref != LUA_NOREF) {
+            luaL_unref(L, LUA_REGISTRYINDEX, t.ref);
+        }
+    }
+    tasks.clear();
+    free_tasks.clear();
+    heap.clear();
+    waiting.clear();
+    ready.clear();
+    signals.clear();
+    ++generation;
+}
+
+std::size_t script_tasks::size() const {
+    return tasks.size() - free_tasks.size();
+}
+
+int script_tasks::lua_wait(lua_State* L) {
+    check_coroutine(L, "wait");
+    auto seconds = luaL_optnumber(L, 1, 0);
+    lua_settop(L, 0);
+    lua_pushnumber(L, seconds);
+    return lua_yield(L, 1);
+}
+
+int script_tasks::lua_wait_until(lua_State* L) {
+    check_coroutine(L, "wait_until");
+    luaL_checkstring(L, 1);
+    lua_settop(L, 1);
+    return lua_yield(L, 1);
+}
+
+int script_tasks::lua_signal(lua_State* L) {
+    auto self = static_cast<script_tasks*>(lua_touserdata(L, lua_upvalueindex(1)));
+    self->signal(luaL_checkstring(L, 1));
+    return 0;
+}
+
+bool script_tasks::is_valid(const task& t) {
+    return entities.exists(t.eid)
+        && entities.has_component<component::script>(t.eid)
+        && entities.has_component<component::net_id>(t.eid)
+        && entities.get_component<component::net_id>(t.eid).id == t.id;
+}
+
+void script_tasks::resume(int index, int nargs) {
+    auto co = tasks[index].thread;
+    auto& rec = scripts.get(tasks[index].handle);
+    auto current = generation;
+
+    // Keeps the thread alive even if it clears its own reference.
+    lua_rawgeti(L, LUA_REGISTRYINDEX, tasks[index].ref);
+
+    auto status = 0;
+    {
+        auto scope = script_budget::call_scope(scripts.get_budget(), rec.budget, nullptr);
+        auto sample = lua_sampler::scope(scripts.get_sampler(), rec.name.c_str(), "run");
+        status = lua_resume(co, L, nargs);
+    }
+
+    if (current != generation) {
+        lua_pop(L, 1);
+        return;
+    }
+
+    if (status == LUA_YIELD) {
+        switch (lua_type(co, -1)) {
+            case LUA_TNUMBER:
+                heap.push_back({now + lua_tonumber(co, -1), next_seq++, index});
+                std::push_heap(begin(heap), end(heap), later<wake>);
+                break;
+            case LUA_TSTRING:
+                waiting[lua_tostring(co, -1)].push_back(index);
+                break;
+            default:
+                heap.push_back({now, next_seq++, index});
+                std::push_heap(begin(heap), end(heap), later<wake>);
+                break;
+        }
+        lua_settop(co, 0);
+    } else {
+        if (status != LUA_OK) {
+            luaL_traceback(L, co, lua_tostring(co, -1), 0);
+            std::cerr << "ERROR: " << rec.name << ".run: " << lua_tostring(L, -1) << std::endl;
+            lua_pop(L, 1);
+        }
+        release(index);
+    }
+
+    lua_pop(L, 1);
+}
+
+void script_tasks::release(int index) {
+    auto& t = tasks[index];
+    luaL_unref(L, LUA_REGISTRYINDEX, t.ref);
+    t = task{};
+    free_tasks.push_back(index);
+}
@@ -0,0 +1,96 @@
+#ifndef LD41_SCRIPT_TASKS_HPP
+#define LD41_SCRIPT_TASKS_HPP
+
+#include "entities.hpp"
+#include "script_registry.hpp"
+
+#include <sol.hpp>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*! Entity scripts written as coroutines.
+ *
+ * A script that defines `run(eid)` gets one coroutine per entity, started the
+ * first time the scripting system sees the entity. Inside it, scripts call
+ *
+ *     wait(seconds)        -- resume after this much game time (next frame if omitted)
+ *     wait_until(event)    -- resume after signal(event) is called
+ *
+ * Sleeping coroutines sit in a min-heap keyed by wake time, so a script that
+ * is waiting costs no Lua calls at all. Signals only wake waiters at the next
+ * update(), never from inside the signalling script.
+ *
+ * A coroutine is dropped when it returns or raises an error, or when its
+ * entity is gone by the time it would resume. Entities are checked by net_id,
+ * so a reused entity slot doesn't inherit a stale coroutine. Coroutines run on
+ * the main state only, even for parallel scripts.
+ */
+class script_tasks {
+public:
+    using ent_id = ember_database::ent_id;
+
+    script_tasks(sol::state_view lua, ember_database& entities, script_registry& scripts);
+    ~script_tasks();
+
+    script_tasks(const script_tasks&) = delete;
+    script_tasks& operator=(const script_tasks&) = delete;
+
+    /*! Starts `rec.run(eid)` and runs it up to its first wait.
+     */
+    void start(const script_registry::record& rec, int handle, ent_id eid);
+
+    /*! Advances game time and resumes every coroutine that is due.
+     */
+    void update(double delta);
+
+    /*! Wakes every coroutine waiting for `event` at the next update().
+     */
+    void signal(const std::string& event);
+
+    /*! Drops every coroutine, e.g. when the stage is unloaded.
+     */
+    void clear();
+
+    std::size_t size() const;
+
+private:
+    struct task {
+        lua_State* thread = nullptr;
+        int ref = LUA_NOREF;
+        int handle = -1;
+        ent_id eid;
+        ember_database::net_id id = 0;
+    };
+
+    struct wake {
+        double time;
+        std::uint64_t seq;
+        int task;
+    };
+
+    static int lua_wait(lua_State* L);
+    static int lua_wait_until(lua_State* L);
+    static int lua_signal(lua_State* L);
+
+    bool is_valid(const task& t);
+    void resume(int index, int nargs);
+    void release(int index);
+
+    lua_State* L;
+    ember_database& entities;
+    script_registry& scripts;
+    std::vector<task> tasks;
+    std::vector<int> free_tasks;
+    std::vector<wake> heap;
+    std::unordered_map<std::string, std::vector<int>> waiting;
+    std::vector<int> ready;
+    std::vector<std::string> signals;
+    std::uint64_t generation = 0; // bumped by clear(), so a resume can tell its task is gone
+    std::uint64_t next_seq = 0;
+    double now = 0;
+};
+
+#endif //LD41_SCRIPT_TASKS_HPP
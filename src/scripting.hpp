@@ -1,6 +1,8 @@
 #ifndef LD41_SCRIPTING_HPP
 #define LD41_SCRIPTING_HPP
 
+#include "json.hpp"
+
 #include <Meta.h>
 #include <sol.hpp>
 
@@ -63,6 +65,10 @@ void register_type(sol::table& lua) {
     type<T>::call(lua);
 }
 
+/*! Converts JSON to Lua values; objects and arrays become new tables.
+ */
+sol::object json_to_lua(sol::state_view lua, const nlohmann::json& json);
+
 } //namespace scripting
 
 #endif //LD41_SCRIPTING_HPP
@@ -1,6 +1,8 @@
 #include "systems.hpp"
 
 #include "components.hpp"
+#include "frame_arena.hpp"
+#include "profiler.hpp"
 
 #include <glm/gtc/matrix_inverse.hpp>
 #include <sushi/frustum.hpp>
@@ -22,8 +24,8 @@ struct collision_manifold {
     component::aabb region;
 };
 
-void collision(DB& entities, double delta, cache<sol::environment>& environment_cache) {
-    std::vector<collision_manifold> collisions;
+void collision(DB& entities, double delta, script_registry& scripts) {
+    frame_vector<collision_manifold> collisions;
 
     entities.visit_pairs(
         [&](DB::ent_id eid1, const component::position& pos1, const component::aabb& aabb1p) {
@@ -56,11 +58,13 @@ void collision(DB& entities, double delta, cache<sol::environment>& environment_
     for (auto& collision : collisions) {
         auto call_script = [&](DB::ent_id eid1, DB::ent_id eid2, const component::aabb& aabb) {
             if (entities.has_component<component::script>(eid1)) {
-                auto& script = entities.get_component<component::script>(eid1);
-                auto script_ptr = environment_cache.get(script.name);
-                auto on_collide = (*script_ptr)["on_collide"];
-                if (on_collide.valid()) {
-                    on_collide(eid1, eid2, aabb);
+                auto& rec = scripts.get(entities.get_component<component::script>(eid1));
+                if (rec.native) {
+                    EMBER_PROFILE_ZONE("native::on_collide");
+                    rec.native->on_collide(scripts.get_native_context(), eid1, eid2, aabb);
+                } else if (rec.on_collide.valid()) {
+                    EMBER_PROFILE_ZONE("lua::on_collide");
+                    scripts.call(rec, rec.on_collide, "on_collide", eid1, eid2, aabb);
                 }
             }
         };
@@ -69,17 +73,117 @@ void collision(DB& entities, double delta, cache<sol::environment>& environment_
     }
 }
 
-void scripting(DB& entities, double delta, cache<sol::environment>& environment_cache) {
+void scripting(DB& entities, double delta, script_registry& scripts, script_tasks& tasks) {
+    // Sleeping coroutines that are due run first, then the updates.
+    tasks.update(delta);
+
+    // Native behaviours and scripts with update_all get one call per frame with
+    // all of their entities, the rest are updated one entity at a time.
+    // Parallel scripts are handed to the workers after everything else, and
+    // scripts whose budget defers updates are run once all are collected.
+    // New entities with a run() are started after the visit.
+    frame_vector<std::pair<int, DB::ent_id>> starting;
     entities.visit(
-        [&](DB::ent_id eid, const component::script& script) {
-            auto update = (*environment_cache.get(script.name))["update"];
-            if (update.valid()) {
-                update(eid, delta);
+        [&](DB::ent_id eid, component::script& script) {
+            auto& rec = scripts.get(script);
+            if (!script.started) {
+                script.started = true;
+                if (rec.run.valid()) {
+                    starting.emplace_back(script.handle, eid);
+                }
+            }
+            if (rec.native || rec.parallel || rec.update_all.valid() || (rec.budget && rec.budget->budget.defer)) {
+                rec.pending.push_back(eid);
+            } else if (rec.update.valid()) {
+                EMBER_PROFILE_ZONE("lua::update");
+                scripts.call(rec, rec.update, "update", eid, delta);
             }
         });
+
+    for (auto& s : starting) {
+        if (entities.exists(s.second)) {
+            tasks.start(scripts.get(s.first), s.first, s.second);
+        }
+    }
+
+    auto remove_destroyed = [&](std::vector<DB::ent_id>& eids) {
+        eids.erase(
+            std::remove_if(begin(eids), end(eids), [&](DB::ent_id eid) {
+                    return !entities.exists(eid);
+                }),
+            end(eids));
+    };
+
+    for (std::size_t handle = 0; handle < scripts.size(); ++handle) {
+        auto& rec = scripts.get(handle);
+        if (rec.pending.empty() || rec.parallel) {
+            continue;
+        }
+
+        if (rec.native) {
+            EMBER_PROFILE_ZONE("native::update_all");
+            remove_destroyed(rec.pending);
+            rec.native->update_all(scripts.get_native_context(), rec.pending, delta);
+            rec.pending.clear();
+            continue;
+        }
+
+        if (!rec.update_all.valid()) {
+            // Round robin, so entities skipped once the budget runs out go first next frame.
+            EMBER_PROFILE_ZONE("lua::update");
+            auto n = rec.pending.size();
+            auto start = rec.resume % n;
+            for (std::size_t k = 0; k < n && rec.update.valid(); ++k) {
+                auto i = (start + k) % n;
+                if (rec.budget->is_exhausted()) {
+                    rec.budget->deferred += n - k;
+                    rec.resume = i;
+                    break;
+                }
+                if (entities.exists(rec.pending[i])) {
+                    scripts.call(rec, rec.update, "update", rec.pending[i], delta);
+                }
+            }
+            rec.pending.clear();
+            continue;
+        }
+
+        EMBER_PROFILE_ZONE("lua::update_all");
+
+        // Earlier updates may have destroyed some of the batch.
+        auto count = std::size_t(0);
+        for (auto eid : rec.pending) {
+            if (entities.exists(eid)) {
+                rec.batch[++count] = eid;
+            }
+        }
+        for (auto i = count + 1; i <= rec.batch_size; ++i) {
+            rec.batch[i] = sol::nil;
+        }
+        rec.batch_size = count;
+        rec.pending.clear();
+
+        scripts.call(rec, rec.update_all, "update_all", rec.batch, delta, count);
+    }
+
+    if (auto workers = scripts.get_workers()) {
+        for (std::size_t handle = 0; handle < scripts.size(); ++handle) {
+            auto& rec = scripts.get(handle);
+            if (rec.parallel) {
+                remove_destroyed(rec.pending);
+                workers->submit(rec.name, rec.pending);
+            }
+        }
+
+        workers->run(delta);
+
+        for (std::size_t handle = 0; handle < scripts.size(); ++handle) {
+            scripts.get(handle).pending.clear();
+        }
+    }
 }
 
-void detection(DB& entities, double delta, cache<sol::environment>& environment_cache) {
+void detection(DB& entities, double delta, script_registry& scripts) {
     //Billi
     entities.visit(
         [&](DB::ent_id tower_eid, component::detector& detector, const component::position& tower_pos){
@@ -88,6 +192,9 @@ void detection(DB& entities, double delta, cache<sol::environment>& environment_
                         return !entities.exists(eid);
                     }),
                 end(detector.entity_list));
+            auto rec = entities.has_component<component::script>(tower_eid)
+                ? &scripts.get(entities.get_component<component::script>(tower_eid))
+                : nullptr;
             entities.visit([&](DB::ent_id enemy_eid, const component::position& enemy_pos, component::enemy_tag){
                     if(tower_eid == enemy_eid)
                         return;
@@ -99,42 +206,31 @@ void detection(DB& entities, double delta, cache<sol::environment>& environment_
                     bool dying = entities.has_component<component::death_timer>(enemy_eid);
 
 
-                    std::function<void(DB::ent_id eid, DB::ent_id other)>
-                        on_enter = [](auto,auto){};
-                    if (entities.has_component<component::script>(tower_eid)) {
-                        auto& script = entities.get_component<component::script>(tower_eid);
-                        auto script_ptr = environment_cache.get(script.name);
-                        auto on_enter_proxy = (*script_ptr)["on_enter"];
-                        if (on_enter_proxy.valid()) {
-                            on_enter = on_enter_proxy;
-                        }
-                    }
-
                     // add entity_id
                     if(!found && within_radius && !dying){
                         detector.entity_list.push_back(enemy_eid);
-                        on_enter(tower_eid, enemy_eid);
-                    }
-                    std::function<void(DB::ent_id eid, DB::ent_id other)>
-                        on_leave = [](auto,auto){};
-                    if (entities.has_component<component::script>(tower_eid)) {
-                        auto& script = entities.get_component<component::script>(tower_eid);
-                        auto script_ptr = environment_cache.get(script.name);
-                        auto on_leave_proxy = (*script_ptr)["on_leave"];
-                        if (on_leave_proxy.valid()) {
-                            on_leave = on_leave_proxy;
+                        if (rec && rec->native) {
+                            rec->native->on_enter(scripts.get_native_context(), tower_eid, enemy_eid);
+                        } else if (rec && rec->on_enter.valid()) {
+                            EMBER_PROFILE_ZONE("lua::on_enter");
+                            scripts.call(*rec, rec->on_enter, "on_enter", tower_eid, enemy_eid);
                         }
                     }
                     //remove entity_id
                     if(found && (!within_radius || dying)){
                         detector.entity_list.erase(iter);
-                        on_leave(tower_eid, enemy_eid);
+                        if (rec && rec->native) {
+                            rec->native->on_leave(scripts.get_native_context(), tower_eid, enemy_eid);
+                        } else if (rec && rec->on_leave.valid()) {
+                            EMBER_PROFILE_ZONE("lua::on_leave");
+                            scripts.call(*rec, rec->on_leave, "on_leave", tower_eid, enemy_eid);
+                        }
                     }
                 });
         });
 }
 
-void death_timer(DB& entities, double delta, cache<sol::environment>& environment_cache) {
+void death_timer(DB& entities, double delta, script_registry& scripts) {
     // Death timer system
     entities.visit(
         [&](DB::ent_id eid) {
@@ -143,11 +239,12 @@ void death_timer(DB& entities, double delta, cache<sol::environment>& environmen
                 timer.time -= delta;
                 if (timer.time <= 0) {
                     if (entities.has_component<component::script>(eid)) {
-                        auto& script = entities.get_component<component::script>(eid);
-                        auto env_ptr = environment_cache.get(script.name);
-                        auto on_death = (*env_ptr)["on_death"];
-                        if (on_death.valid()) {
-                            on_death(eid);
+                        auto& rec = scripts.get(entities.get_component<component::script>(eid));
+                        if (rec.native) {
+                            rec.native->on_death(scripts.get_native_context(), eid);
+                        } else if (rec.on_death.valid()) {
+                            EMBER_PROFILE_ZONE("lua::on_death");
+                            scripts.call(rec, rec.on_death, "on_death", eid);
                         }
                     }
                     entities.destroy_entity(eid);
@@ -163,6 +260,7 @@ void death_timer(DB& entities, double delta, cache<sol::environment>& environmen
 }
 
 void render(DB& entities, double delta, glm::mat4 proj, glm::mat4 view, sushi::static_mesh& sprite_mesh, cache<sushi::texture_2d>& texture_cache, cache<nlohmann::json>& animation_cache) {
+    EMBER_PROFILE_ZONE("render::entities");
     auto frustum = sushi::frustum(proj*view);
     entities.visit(
         [&](DB::ent_id eid, const component::position& pos, component::animation& anim){
@@ -200,7 +298,7 @@ void render(DB& entities, double delta, glm::mat4 proj, glm::mat4 view, sushi::s
         });
 }
 
-void fire_damage(DB& entities, double delta) {
+void fire_damage(DB& entities, double delta, command_buffer& commands) {
     entities.visit(
         [&](DB::ent_id eid, component::fire_damage& fire, component::health& health){
             fire.next -= delta;
@@ -212,11 +310,11 @@ void fire_damage(DB& entities, double delta) {
             }
 
             if (fire.duration <= 0) {
-                entities.destroy_component<component::fire_damage>(eid);
+                commands.destroy_component<component::fire_damage>(eid);
             }
 
             if (health.max_health <= 0) {
-                entities.create_component(eid, component::death_timer{});
+                commands.create_component(eid, component::death_timer{});
             }
         });
 }
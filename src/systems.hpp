@@ -1,8 +1,11 @@
 #ifndef LD41_SYSTEMS_HPP
 #define LD41_SYSTEMS_HPP
 
+#include "command_buffer.hpp"
 #include "entities.hpp"
 #include "resource_cache.hpp"
+#include "script_registry.hpp"
+#include "script_tasks.hpp"
 #include "json.hpp"
 
 #include <glm/glm.hpp>
@@ -18,12 +21,12 @@ template <typename T>
 using cache = resource_cache<T, std::string>;
 
 void movement(DB& entities, double delta);
-void collision(DB& entities, double delta, cache<sol::environment>& environment_cache);
-void scripting(DB& entities, double delta, cache<sol::environment>& environment_cache);
-void detection(DB& entities, double delta, cache<sol::environment>& environment_cache);
-void death_timer(DB& entities, double delta, cache<sol::environment>& environment_cache);
+void collision(DB& entities, double delta, script_registry& scripts);
+void scripting(DB& entities, double delta, script_registry& scripts, script_tasks& tasks);
+void detection(DB& entities, double delta, script_registry& scripts);
+void death_timer(DB& entities, double delta, script_registry& scripts);
 void render(DB& entities, double delta, glm::mat4 proj, glm::mat4 view, sushi::static_mesh& sprite_mesh, cache<sushi::texture_2d>& texture_cache, cache<nlohmann::json>& animation_cache);
-void fire_damage(DB& entities, double delta);
+void fire_damage(DB& entities, double delta, command_buffer& commands);
 
 } //namespace systems
 
@@ -0,0 +1,89 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+thread_pool::thread_pool(std::size_t num_workers) {
+    workers.reserve(num_workers);
+    for (std::size_t i = 0; i < num_workers; ++i) {
+        workers.emplace_back([this]{ worker_main(); });
+    }
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        stopping = true;
+    }
+    job_ready.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+std::size_t thread_pool::size() const {
+    return workers.size();
+}
+
+void thread_pool::submit(std::function<void()> job) {
+    if (workers.empty()) {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock (mutex);
+        jobs.push_back(std::move(job));
+        ++in_flight;
+    }
+    job_ready.notify_one();
+}
+
+void thread_pool::wait() {
+    std::unique_lock<std::mutex> lock (mutex);
+    jobs_done.wait(lock, [&]{ return in_flight == 0; });
+    if (error) {
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+}
+
+std::size_t thread_pool::default_size() {
+#ifdef __EMSCRIPTEN__
+    return 0;
+#else
+    auto hw = std::thread::hardware_concurrency();
+    return hw > 1 ? std::min<std::size_t>(hw - 1, 4) : 0;
+#endif
+}
+
+void thread_pool::worker_main() {
+    while (true) {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock (mutex);
+            job_ready.wait(lock, [&]{ return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        auto job_error = std::exception_ptr{};
+        try {
+            job();
+        } catch (...) {
+            job_error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock (mutex);
+            if (job_error && !error) {
+                error = job_error;
+            }
+            --in_flight;
+        }
+        jobs_done.notify_all();
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef LD41_THREAD_POOL_HPP
+#define LD41_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*! Fixed-size pool of worker threads.
+ *
+ * Jobs are run in submission order by whichever worker is free.
+ * A pool with zero workers runs every job inline in `submit()`, which is what
+ * builds without thread support (Emscripten) get.
+ */
+class thread_pool {
+public:
+    thread_pool(std::size_t num_workers);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    std::size_t size() const;
+
+    void submit(std::function<void()> job);
+
+    /*! Blocks until every submitted job has finished.
+     *
+     * Rethrows the first exception thrown by a job since the last wait.
+     */
+    void wait();
+
+    static std::size_t default_size();
+
+private:
+    void worker_main();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable job_ready;
+    std::condition_variable jobs_done;
+    std::size_t in_flight = 0;
+    std::exception_ptr error;
+    bool stopping = false;
+};
+
+#endif //LD41_THREAD_POOL_HPP
@@ -1,6 +1,7 @@
 #ifndef LD41_UTILITY_HPP
 #define LD41_UTILITY_HPP
 
+#include <iterator>
 #include <utility>
 
 #define EMBER_CAT_IMPL(A,B) A##B
@@ -4,5 +4,53 @@ var EmberConfig = {
         width: 640,
         height: 480
     },
-    volume: 0.3
+    volume: 0.3,
+    flight_recorder: {
+        frames: 300,
+        budget_ms: 50
+    },
+    frame_timing: {
+        budget_ms: 16.7,
+        dump_interval: 0,
+        dump_file: "ld41_frame_timing.csv"
+    },
+    alloc_tracker: {
+        attribution: false,
+        warmup_frames: 300,
+        budget: -1,
+        fail_on_budget: false
+    },
+    lua_gc: {
+        budget_ms: 1.0,
+        idle_budget_ms: 4.0,
+        pause: 1.5,
+        runaway: 4.0,
+        step_kb: 16
+    },
+    native_behaviours: true,
+    native_stage_loader: true,
+    script_budget: {
+        hook_interval: 1000,
+        default: {
+            call_instructions: 10000000,
+            call_ms: 100,
+            frame_ms: -1,
+            defer: false
+        },
+        scripts: {}
+    },
+    lua_sampler: {
+        enabled: false,
+        period_ms: 1.0,
+        max_depth: 16,
+        output: "ld41_lua_stacks.txt"
+    },
+    lua_workers: {
+        states: 0,
+        min_batch: 32
+    },
+    lua_bytecode: {
+        write: true,
+        strip: false
+    }
 };
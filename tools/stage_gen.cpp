@@ -0,0 +1,300 @@
+// Writes a synthetic stage for scale testing, in the format of data/stages:
+//
+//     ld41_stage_gen --name stress --width 64 --height 48 --turns 12 --towers 0.5
+//                    --spawners 8 --spawn-count 1000 --spawn-rate 0.1 --enemies 5000
+//
+// Creates <out>/<name>.json and <out>/pathlogic/<name>pathlogic.json. The path
+// runs from the top edge to the bottom edge and turns sideways `turns` times.
+// A `towers` fraction of the tiles next to the path become tower tiles with a
+// random tower from data/towers.json built on them. Each spawner at the start
+// of the path releases `spawn-count` enemies, one every `spawn-rate` seconds
+// (shrinking by `spawn-decay` each time). `enemies` more are placed along the
+// path from the first tick. The same seed always gives the same stage.
+
+#include "json.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct options {
+    std::string name = "stress";
+    std::string data = "data";
+    std::string out = "data/stages";
+    int width = 20;
+    int height = 15;
+    int turns = 4;
+    double towers = 0.25;
+    int spawners = 1;
+    int spawn_count = 50;
+    double spawn_rate = 1;
+    double spawn_decay = 0.99;
+    double first_spawn = 5;
+    int enemies = 0;
+    unsigned seed = 1;
+};
+
+struct cell {
+    int x;
+    int y;
+};
+
+enum direction { up = 1, down = 2, left = 4, right = 8 };
+
+int get_direction(cell from, cell to) {
+    if (to.y < from.y) return up;
+    if (to.y > from.y) return down;
+    if (to.x < from.x) return left;
+    return right;
+}
+
+// Tile indices of the tileset mesh, see the tile renderer in main.cpp.
+int get_tile(int dirs) {
+    switch (dirs) {
+        case up | down: return 1;
+        case up | right: return 2;
+        case left | right: return 3;
+        case left | up: return 4;
+        case left | down: return 5;
+        case down | right: return 6;
+        default: return 0;
+    }
+}
+
+nlohmann::json load_json(const std::string& filename) {
+    std::ifstream file (filename);
+    if (!file) {
+        throw std::runtime_error("cannot open " + filename);
+    }
+    nlohmann::json json;
+    file >> json;
+    return json;
+}
+
+bool write_json(const std::string& filename, const nlohmann::json& json) {
+    std::ofstream file (filename);
+    file << json.dump(4) << '\n';
+    return bool(file);
+}
+
+void print_usage() {
+    std::cerr << "Usage: ld41_stage_gen [--name N] [--data DIR] [--out DIR] [--width W] [--height H] [--turns T]\n"
+                 "                      [--towers FRACTION] [--spawners N] [--spawn-count N] [--spawn-rate SECONDS]\n"
+                 "                      [--spawn-decay D] [--first-spawn SECONDS] [--enemies N] [--seed S]" << std::endl;
+}
+
+bool parse_options(int argc, char* argv[], options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        auto arg = std::string(argv[i]);
+        if (i + 1 >= argc) {
+            return false;
+        }
+        auto value = std::string(argv[++i]);
+        if (arg == "--name") opts.name = value;
+        else if (arg == "--data") opts.data = value;
+        else if (arg == "--out") opts.out = value;
+        else if (arg == "--width") opts.width = std::stoi(value);
+        else if (arg == "--height") opts.height = std::stoi(value);
+        else if (arg == "--turns") opts.turns = std::stoi(value);
+        else if (arg == "--towers") opts.towers = std::stod(value);
+        else if (arg == "--spawners") opts.spawners = std::stoi(value);
+        else if (arg == "--spawn-count") opts.spawn_count = std::stoi(value);
+        else if (arg == "--spawn-rate") opts.spawn_rate = std::stod(value);
+        else if (arg == "--spawn-decay") opts.spawn_decay = std::stod(value);
+        else if (arg == "--first-spawn") opts.first_spawn = std::stod(value);
+        else if (arg == "--enemies") opts.enemies = std::stoi(value);
+        else if (arg == "--seed") opts.seed = std::stoul(value);
+        else return false;
+    }
+    return opts.width >= 3 && opts.height >= 3;
+}
+
+} //static
+
+int main(int argc, char* argv[]) try {
+    auto opts = options{};
+    if (!parse_options(argc, argv, opts)) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    auto rng = std::mt19937(opts.seed);
+    auto random_x = std::uniform_int_distribution<>(1, opts.width - 2);
+    auto chance = std::uniform_real_distribution<>(0, 1);
+
+    const auto enemy_types = load_json(opts.data + "/enemies.json");
+    const auto tower_types = load_json(opts.data + "/towers.json");
+
+    // Turn rows are distinct, so horizontal runs never cross.
+    auto rows = std::vector<int>{};
+    for (int y = 1; y < opts.height - 1; ++y) {
+        rows.push_back(y);
+    }
+    std::shuffle(begin(rows), end(rows), rng);
+    rows.resize(std::min<std::size_t>(std::max(opts.turns, 0), rows.size()));
+    std::sort(begin(rows), end(rows));
+
+    // Path cells in order, the corners of the path, and for each cell the
+    // index of the corner it is heading to.
+    auto cells = std::vector<cell>{};
+    auto corners = std::vector<cell>{};
+    auto next_corner = std::vector<int>{};
+
+    auto x = random_x(rng);
+    auto y = 0;
+    corners.push_back({x, y});
+    cells.push_back({x, y});
+    next_corner.push_back(1);
+
+    auto walk_to = [&](int tx, int ty) {
+        while (x != tx || y != ty) {
+            if (y != ty) {
+                y += ty > y ? 1 : -1;
+            } else {
+                x += tx > x ? 1 : -1;
+            }
+            cells.push_back({x, y});
+            next_corner.push_back(int(corners.size()) + (x == tx && y == ty ? 1 : 0));
+        }
+        corners.push_back({x, y});
+    };
+
+    for (auto row : rows) {
+        walk_to(x, row);
+        auto new_x = random_x(rng);
+        while (new_x == x && opts.width > 3) {
+            new_x = random_x(rng);
+        }
+        if (new_x != x) {
+            walk_to(new_x, row);
+        }
+    }
+    walk_to(x, opts.height - 1);
+
+    auto tiles = std::vector<int>(opts.width * opts.height, 0);
+    auto tile_at = [&](int cx, int cy) -> int& { return tiles[cy * opts.width + cx]; };
+
+    for (std::size_t i = 0; i < cells.size(); ++i) {
+        auto prev = i > 0 ? cells[i - 1] : cell{cells[i].x, cells[i].y - 1};
+        auto next = i + 1 < cells.size() ? cells[i + 1] : cell{cells[i].x, cells[i].y + 1};
+        tile_at(cells[i].x, cells[i].y) = get_tile(get_direction(cells[i], prev) | get_direction(cells[i], next));
+    }
+
+    auto stage = nlohmann::json::object();
+    auto& ents = stage["entities"] = nlohmann::json::array();
+
+    auto position = [](int px, int py) {
+        return nlohmann::json{{"x", px}, {"y", -py}};
+    };
+
+    const auto& start = corners.front();
+    const auto& finish = corners.back();
+
+    ents.push_back({
+        {"script", {{"name", "player"}}},
+        {"position", position(finish.x, finish.y)},
+        {"aabb", {{"left", -0.5}, {"right", 0.5}, {"bottom", -0.5}, {"top", 0.5}}},
+        {"health", {{"max_health", 3}}}});
+
+    ents.push_back({
+        {"position", position(finish.x, finish.y)},
+        {"ball", nlohmann::json::object()},
+        {"script", {{"name", "actor/ball"}}},
+        {"animation", {{"name", "ball"}, {"cycle", "height_1"}, {"frame", 0}, {"t", 0}}}});
+
+    for (int i = 0; i < opts.spawners; ++i) {
+        auto spawnrates = nlohmann::json::array();
+        for (std::size_t t = 0; t < enemy_types.size(); ++t) {
+            auto count = opts.spawn_count / int(enemy_types.size()) + (int(t) < opts.spawn_count % int(enemy_types.size()) ? 1 : 0);
+            if (count > 0) {
+                spawnrates.push_back({enemy_types[t]["name"], count});
+            }
+        }
+        if (spawnrates.empty()) {
+            continue;
+        }
+        ents.push_back({
+            {"position", position(start.x, start.y)},
+            {"script", {{"name", "actor/spawner"}}},
+            {"spawner", {
+                {"next_spawn", opts.first_spawn + i * opts.spawn_rate / opts.spawners},
+                {"rate", opts.spawn_rate},
+                {"decay", opts.spawn_decay},
+                {"spawnrates", spawnrates}}}});
+    }
+
+    // Tower tiles: grass next to the path, in a fixed scan order so the seed decides.
+    auto num_towers = 0;
+    for (int cy = 0; cy < opts.height; ++cy) {
+        for (int cx = 0; cx < opts.width; ++cx) {
+            if (tile_at(cx, cy) != 0) {
+                continue;
+            }
+            auto is_path = [&](int nx, int ny) {
+                return nx >= 0 && ny >= 0 && nx < opts.width && ny < opts.height && tile_at(nx, ny) != 0 && tile_at(nx, ny) != 7;
+            };
+            if (!is_path(cx - 1, cy) && !is_path(cx + 1, cy) && !is_path(cx, cy - 1) && !is_path(cx, cy + 1)) {
+                continue;
+            }
+            if (chance(rng) >= opts.towers) {
+                continue;
+            }
+            tile_at(cx, cy) = 7;
+            auto tower = tower_types[rng() % tower_types.size()]["template"];
+            tower["position"] = position(cx, cy);
+            ents.push_back(tower);
+            ++num_towers;
+        }
+    }
+
+    for (int i = 0; i < opts.enemies; ++i) {
+        // Never on the finish cell, whose next corner is past the end of the path.
+        auto c = std::min(cells.size() * i / opts.enemies, cells.size() - 2);
+        auto enemy = enemy_types[rng() % enemy_types.size()]["template"];
+        enemy["position"] = position(cells[c].x, cells[c].y);
+        enemy["velocity"] = {{"vx", 0}, {"vy", 0}};
+        enemy["pathing"] = {{"next_tile", next_corner[c]}};
+        ents.push_back(enemy);
+    }
+
+    auto& tileset = stage["tileset"] = nlohmann::json::array();
+    for (int cy = 0; cy < opts.height; ++cy) {
+        for (int cx = 0; cx < opts.width; ++cx) {
+            tileset.push_back({
+                {"x", cx},
+                {"y", cy},
+                {"rot", 0},
+                {"tile", tile_at(cx, cy)},
+                {"flipX", false},
+                {"index", cy * opts.width + cx}});
+        }
+    }
+
+    auto pathlogic = nlohmann::json::array();
+    for (const auto& c : corners) {
+        pathlogic.push_back(position(c.x, c.y));
+    }
+
+    auto stage_file = opts.out + "/" + opts.name + ".json";
+    auto path_file = opts.out + "/pathlogic/" + opts.name + "pathlogic.json";
+
+    if (!write_json(stage_file, stage) || !write_json(path_file, pathlogic)) {
+        std::cerr << "ERROR: Failed to write " << stage_file << " or " << path_file << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Wrote " << stage_file << ": " << opts.width << "x" << opts.height << ", " << corners.size() << " path points, "
+              << num_towers << " towers, " << opts.spawners << " spawners x " << opts.spawn_count << " enemies, "
+              << opts.enemies << " enemies placed" << std::endl;
+
+    return EXIT_SUCCESS;
+} catch (const std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+}